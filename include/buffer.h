@@ -0,0 +1,69 @@
+// Buffer di byte dinamico usato per accumulare i dati ricevuti dai socket
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Buffer di byte dinamico
+ * @param data Area di memoria contenente i byte
+ * @param length Numero di byte validi presenti nel buffer
+ * @param capacity Dimensione dell'area allocata
+ * @note Un buffer azzerato con memset è un buffer vuoto valido
+ */
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} ByteBuffer;
+
+/**
+ * Aggiunge dei byte in coda al buffer, allargandolo se necessario
+ * @param buffer ByteBuffer* di destinazione
+ * @param data byte da aggiungere
+ * @param length numero di byte da aggiungere
+ * @return true se i byte sono stati aggiunti, false se l'allocazione fallisce
+ */
+bool append_to_buffer(ByteBuffer* buffer, const void* data, size_t length);
+
+/**
+ * Garantisce spazio libero in coda al buffer senza cambiarne il contenuto
+ * @param buffer ByteBuffer* da allargare
+ * @param extra numero di byte che devono poter essere aggiunti senza riallocare
+ * @return true se lo spazio è disponibile, false se l'allocazione fallisce
+ * @note Una riallocazione invalida i puntatori ai byte del buffer
+ */
+bool reserve_buffer(ByteBuffer* buffer, size_t extra);
+
+/**
+ * Aggiunge testo formattato in coda al buffer
+ * @param buffer ByteBuffer* di destinazione
+ * @param format formato come printf
+ * @return true se il testo è stato aggiunto, false se l'allocazione fallisce
+ * @note Il testo viene scritto direttamente nello spazio libero del buffer,
+ * che resta terminato da '\0' (non conteggiato in length)
+ */
+bool append_format(ByteBuffer* buffer, const char* format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * Svuota il buffer mantenendo la memoria allocata
+ * @param buffer ByteBuffer* da svuotare
+ */
+void clear_buffer(ByteBuffer* buffer);
+
+/**
+ * Rimuove dei byte dalla testa del buffer
+ * @param buffer ByteBuffer* da cui rimuovere i byte
+ * @param length numero di byte da rimuovere
+ */
+void consume_buffer(ByteBuffer* buffer, size_t length);
+
+/**
+ * Libera la memoria del buffer e lo riporta allo stato vuoto
+ * @param buffer ByteBuffer* da liberare
+ */
+void release_buffer(ByteBuffer* buffer);
+
+#endif
@@ -4,18 +4,77 @@
 #include "common.h"
 #include <stdbool.h>
 
+// Voci per pagina mostrate dal comando 'show top'
+#define SCORE_PAGE_SIZE 10
+// Punteggi possibili in un quiz, uno per lista della classifica conservata
+#define SCORE_BUCKETS (QUESTIONS_PER_QUIZ + 1)
+
+/**
+ * Voce della classifica conservata dal client
+ * @param nickname nickname del giocatore
+ * @param scores punteggi dei quiz Sport (0) e Geografia (1)
+ * @param flags quiz completati (SCORE_FLAG_*)
+ * @param hash hash del nickname, per ricostruire score_index senza ricalcolarlo
+ * @param prev per ogni quiz, posizione in scores della voce precedente con lo
+ * stesso punteggio (-1 se è la prima)
+ * @param next per ogni quiz, posizione della voce successiva con lo stesso
+ * punteggio (-1 se è l'ultima)
+ * @note I collegamenti sono posizioni e non puntatori perché scores viene riallocato
+ */
+typedef struct {
+    char nickname[MAX_NICK_LENGTH];
+    uint32_t scores[2];
+    uint8_t flags;
+    uint32_t hash;
+    int prev[2];
+    int next[2];
+} ScoreEntry;
+
 /**
  * Struttura che rappresenta lo stato del client
  * @param socket Socket di connessione al server
  * @param nickname Nickname del giocatore
  * @param current_quiz Quiz attualmente selezionato (1 per sport, 2 per geografia)
  * @param current_question Numero della domanda corrente
+ * @param protocol_version Versione del protocollo negoziata con il server
+ * @param pipeline true se ogni risposta viene inviata insieme alla richiesta della classifica
+ * @param pending_scores Classifiche richieste in pipeline e non ancora ricevute
+ * @param next_message Messaggio arrivato dentro un MSG_ANSWER_NEXT, restituito
+ * dalla ricezione successiva
+ * @param next_buffer Payload ricevuto che contiene next_message (NULL se nessuno)
+ * @param scores Classifica ricevuta dal server (protocollo v2), aggiornata
+ * con le sole voci cambiate ad ogni richiesta
+ * @param score_count Numero di voci in scores
+ * @param score_capacity Capacità di scores
+ * @param score_index Tabella hash a indirizzamento aperto dei nickname di scores:
+ * ogni voce contiene una posizione in scores, -1 se vuota
+ * @param score_index_capacity Numero di voci di score_index, potenza di 2 (0 se non allocata)
+ * @param score_version Versione di scores, inviata con MSG_REQUEST_SCORE (0 se nessuna)
+ * @param score_first Per ogni quiz e punteggio, posizione in scores della prima
+ * voce con quel punteggio (-1 se nessuna)
+ * @param score_last Per ogni quiz e punteggio, posizione dell'ultima voce
+ * @note Le liste per punteggio tengono scores ordinata per ogni quiz mentre
+ * arrivano le voci cambiate, come le classifiche del server: la classifica si
+ * compone visitandole, senza ordinare
  */
 typedef struct {
     int socket;
     char nickname[MAX_NICK_LENGTH];
     int current_quiz;
     int current_question;
+    int protocol_version;
+    bool pipeline;
+    int pending_scores;
+    Message next_message;
+    char* next_buffer;
+    ScoreEntry* scores;
+    int score_count;
+    int score_capacity;
+    int* score_index;
+    int score_index_capacity;
+    uint32_t score_version;
+    int score_first[2][SCORE_BUCKETS];
+    int score_last[2][SCORE_BUCKETS];
 } ClientState;
 
 // Funzioni di inizializzazione e gestione del client
@@ -40,6 +99,27 @@ void cleanup_client(ClientState* state);
  */
 bool connect_to_server(ClientState* state, int port);
 
+/**
+ * Invia un messaggio al server con la versione del protocollo negoziata
+ * @param state struttura ClientState
+ * @param msg messaggio da inviare
+ * @return numero di byte inviati o ERR_SEND in caso di errore
+ */
+ssize_t send_to_server(ClientState* state, Message* msg);
+
+/**
+ * Riceve un messaggio dal server e, con il protocollo v2, ne compone il testo
+ * @param state struttura ClientState
+ * @param msg puntatore al messaggio da ricevere
+ * @return numero di byte ricevuti o -1 in caso di errore
+ * @note Con il protocollo v2 il payload strutturato viene sostituito dal testo
+ * da mostrare, quindi il resto del client non dipende dalla versione.
+ * MSG_VERSION aggiorna la versione negoziata e non viene restituito
+ * @note Un MSG_ANSWER_NEXT viene restituito come MSG_ANSWER_RESULT e il
+ * messaggio che contiene dalla chiamata successiva, senza leggere dal socket
+ */
+ssize_t receive_server_message(ClientState* state, Message* msg);
+
 /**
  * Disconnette il client dal server
  * @param state struttura ClientState
@@ -106,7 +186,7 @@ bool print_answer_result(Message* msg);
  * @param state struttura ClientState
  * @param answer comando inserito dall'utente
  * @return true se il comando è stato gestito, false se non è un comando speciale
- * @note Gestisce comandi come 'show score' e 'endquiz'
+ * @note Gestisce comandi come 'show score', 'show top [pagina]', 'show rank' e 'endquiz'
  */
 bool handle_special_commands(ClientState* state, const char* answer);
 
@@ -117,6 +197,8 @@ bool handle_special_commands(ClientState* state, const char* answer);
  * @return true se l'invio ha avuto successo, false altrimenti
  * @note Prepara e invia un messaggio di tipo MSG_ANSWER
  * @note Gestisce la ricezione del risultato della risposta dal server
+ * @note In modalità pipeline la richiesta della classifica parte con la risposta;
+ * la classifica viene ricevuta da answer_question() prima della domanda successiva
  */
 bool submit_and_verify_answer(ClientState* state, const char* answer);
 
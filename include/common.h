@@ -6,8 +6,10 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <stdbool.h>
 #include "constants.h"
 #include "debug.h"
+#include "protocol.h"
 
 /**
  * Struttura per rappresentare un messaggio
@@ -24,6 +26,18 @@ typedef struct {
     char *payload;
 } Message;
 
+/**
+ * Header di un messaggio così come viaggia sulla rete nel protocollo v1
+ * @param type tipo del messaggio
+ * @param length lunghezza del payload in network byte order
+ * @note La dimensione dipende dalla rappresentazione dell'enum: resta solo
+ * per i client v1, il protocollo v2 usa encode_header_v2()
+ */
+typedef struct {
+    MessageType type;
+    uint32_t length;
+} NetworkHeader;
+
 // Funzioni di utilità rete
 
 /**
@@ -40,21 +54,78 @@ int create_socket();
  */
 int setup_connection(const char* ip, int port);
 
+/**
+ * Imposta un socket in modalità non bloccante
+ * @param sock file descriptor del socket
+ * @return true se l'operazione ha successo, false altrimenti
+ */
+bool set_nonblocking(int sock);
+
+/**
+ * Disabilita l'algoritmo di Nagle su un socket TCP
+ * @param sock file descriptor del socket
+ * @return true se l'operazione ha successo, false altrimenti
+ * @note Da usare quando i messaggi vengono già raggruppati prima della send
+ */
+bool set_nodelay(int sock);
+
 /**
  * Invia un messaggio al socket
  * @param sock file descriptor del socket
  * @param msg messaggio da inviare
+ * @param version versione del protocollo con cui codificare l'header
  * @return numero di byte inviati o ERR_SEND in caso di errore
+ * @note Header e payload vengono inviati con una sola sendmsg
  */
-ssize_t send_message(int sock, Message* msg);
+ssize_t send_message(int sock, Message* msg, int version);
+
+/**
+ * Invia più messaggi consecutivi al socket
+ * @param sock file descriptor del socket
+ * @param msgs array di messaggi da inviare
+ * @param count numero di messaggi, al più MAX_BATCH_MESSAGES
+ * @param version versione del protocollo con cui codificare gli header
+ * @return numero di byte inviati o ERR_SEND in caso di errore
+ * @note Tutti i messaggi partono con una sola sendmsg: il destinatario li
+ * riceve insieme e può elaborarli senza attendere altri round trip
+ */
+ssize_t send_messages(int sock, Message* msgs, int count, int version);
 
 /**
  * Riceve un messaggio dal socket
  * @param sock file descriptor del socket
  * @param msg puntatore al messaggio da ricevere
+ * @param version versione del protocollo con cui decodificare l'header
  * @return numero di byte ricevuti o -1 in caso di errore
+ * @note Bloccante: attende header e payload completi, adatta al client.
+ * Il server usa invece parse_message() sui byte già ricevuti
+ * @note In v2 i frame con MSG_FLAG_MORE vengono ricomposti con quelli che li
+ * seguono in un unico messaggio, lungo al più MAX_STREAM_LENGTH byte
+ */
+ssize_t receive_message(int sock, Message* msg, int version);
+
+/**
+ * Scrive l'header di rete di un messaggio
+ * @param msg messaggio di cui codificare l'header
+ * @param version versione del protocollo
+ * @param out buffer di destinazione, grande almeno sizeof(NetworkHeader)
+ * (che contiene anche un header v2)
+ * @return numero di byte scritti
+ */
+size_t encode_message_header(const Message* msg, int version, char* out);
+
+/**
+ * Estrae un messaggio completo da un buffer di byte già ricevuti
+ * @param data byte ricevuti
+ * @param length numero di byte disponibili
+ * @param msg puntatore al messaggio da riempire
+ * @param version versione del protocollo con cui decodificare l'header
+ * @return numero di byte consumati dal buffer, 0 se il messaggio non è
+ * ancora completo, ERR_RECV se l'header non è valido
+ * @note Il payload non viene copiato: punta ai byte di data, non è terminato
+ * da '\0' e resta valido finché il buffer non viene modificato
  */
-ssize_t receive_message(int sock, Message* msg);
+ssize_t parse_message(const char* data, size_t length, Message* msg, int version);
 
 /**
  * Converte un MessageType in stringa
@@ -63,4 +134,13 @@ ssize_t receive_message(int sock, Message* msg);
  */
 const char* message_type_to_string(MessageType type);
 
+/**
+ * Calcola l'hash di un nickname (FNV-1a a 32 bit)
+ * @param nickname caratteri del nickname, non necessariamente terminati da '\0'
+ * @param length numero di caratteri
+ * @return hash del nickname
+ * @note Usato dal registro dei giocatori del server e dalla classifica del client
+ */
+uint32_t hash_nickname(const char* nickname, size_t length);
+
 #endif
\ No newline at end of file
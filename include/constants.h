@@ -3,11 +3,52 @@
 #define CONSTANTS_H
 
 // Limiti di sistema
-#define MAX_CLIENTS (FD_SETSIZE - 4)  // -4 per socket listener e stdin/stdout/stderr
+// Numero massimo di eventi restituiti da una singola attesa sul ciclo di eventi
+#define EVENT_BATCH_SIZE 256
+// Capacità iniziale della tabella dei client (cresce su richiesta)
+#define INITIAL_CLIENT_TABLE_SIZE 64
+// Numero di client per pagina del slab delle connessioni
+#define CLIENT_SLAB_PAGE_SIZE 64
+// Lunghezza di default della coda delle connessioni in attesa di accept
+// (il kernel la limita comunque a net.core.somaxconn)
+#define DEFAULT_LISTEN_BACKLOG 4096
+// Numero massimo di thread worker avviabili con --workers
+#define MAX_WORKERS 64
+// Byte in uscita accodati per un client oltre i quali il client viene disconnesso
+#define OUTPUT_HIGH_WATER_MARK (256 * 1024)
+// Byte ricevuti e non ancora elaborati tollerati per un client
+// (deve contenere almeno un messaggio di MAX_PAYLOAD_LENGTH byte)
+#define INPUT_HIGH_WATER_MARK (256 * 1024)
+// Byte di una classifica accodati per volta: il pezzo successivo viene accodato
+// solo quando l'uscita del client scende sotto questa soglia. Anche le voci
+// cambiate di una classifica v2 vengono inviate solo se stanno in un pezzo
+#define SCOREBOARD_CHUNK_SIZE (16 * 1024)
+// Lunghezza massima di un messaggio ricevuto dal client, anche se diviso in più frame
+#define MAX_STREAM_LENGTH (64 * 1024 * 1024)
+// Messaggi di un client elaborati per ogni evento prima di passare agli altri client
+#define MAX_FRAMES_PER_EVENT 16
+// Messaggi inviabili insieme con una sola send_messages()
+#define MAX_BATCH_MESSAGES 8
+// Slot della submission queue io_uring di ogni worker
+#define URING_QUEUE_DEPTH 256
+// Buffer forniti al kernel per le recv io_uring (potenza di 2)
+#define URING_BUFFER_COUNT 512
+// Dimensione di ciascun buffer fornito
+#define URING_BUFFER_SIZE 2048
+// Durata di un tick del timer wheel in millisecondi
+#define TIMER_TICK_MS 100
+// Tempo concesso ad un client appena connesso per completare il login
+#define LOGIN_TIMEOUT_MS (2 * 60 * 1000)
+// Tempo massimo senza ricevere dati da un client prima della disconnessione
+#define IDLE_TIMEOUT_MS (10 * 60 * 1000)
+// Tempo massimo per completare un messaggio di cui è arrivata solo una parte
+#define PARTIAL_FRAME_TIMEOUT_MS (10 * 1000)
+// Attesa massima per l'invio del messaggio di chiusura con il motore io_uring
+#define SHUTDOWN_DRAIN_MS 500
 // Capacità iniziale dell'array di giocatori
 #define INITIAL_PLAYER_ARRAY_SIZE 10
-// Numero massimo di giocatori
-#define MAX_PLAYERS 1020
+// Numero di giocatori per pagina del registro dei giocatori
+#define PLAYER_PAGE_SIZE 256
 
 // Limiti buffer
 #define BUFFER_SIZE 1024
@@ -15,6 +56,8 @@
 
 // Limite lunghezza messaggio
 #define MAX_MSG_LEN 512
+// Limite lunghezza del payload accettato da un client
+#define MAX_PAYLOAD_LENGTH 65536
 // Limite lunghezza nickname
 #define MAX_NICK_LENGTH 20 + 1
 // Limite numero di domande per quiz
@@ -51,6 +94,11 @@ typedef enum {
     MSG_END_QUIZ,              // Server notifica fine del quiz corrente
     MSG_DISCONNECT,            // Client/Server notifica disconnessione
     MSG_ERROR,                // Server notifica un errore generico
+    MSG_VERSION,              // Server conferma la versione del protocollo negoziata
+    MSG_ANSWER_NEXT,          // Server invia il risultato della risposta insieme al messaggio successivo (v2)
+    MSG_SCORE_PAGE,           // Server invia una pagina della classifica di un quiz (v2)
+    MSG_REQUEST_RANK,         // Client richiede la propria posizione nella classifica di un quiz (v2)
+    MSG_RANK,                 // Server invia la posizione del giocatore e le voci vicine (v2)
 } MessageType;
 
 // Codici di stato/errore
@@ -0,0 +1,77 @@
+// Astrazione del ciclo di eventi del server basata su epoll
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+
+/**
+ * Ciclo di eventi basato su epoll
+ * @param epoll_fd File descriptor dell'istanza epoll
+ * @param events Buffer in cui epoll_wait deposita gli eventi pronti, con il
+ * token di registrazione in data.u64
+ * @param max_events Dimensione del buffer degli eventi
+ * @note A differenza di select() non c'è un limite di FD_SETSIZE descrittori
+ * e ad ogni risveglio vengono restituiti solo i descrittori pronti
+ */
+typedef struct {
+    int epoll_fd;
+    struct epoll_event* events;
+    int max_events;
+} EventLoop;
+
+/**
+ * Crea un nuovo ciclo di eventi
+ * @param max_events numero massimo di eventi restituiti da una singola attesa
+ * @return EventLoop* inizializzato o NULL in caso di errore
+ */
+EventLoop* create_event_loop(int max_events);
+
+/**
+ * Libera le risorse del ciclo di eventi
+ * @param loop EventLoop* da liberare
+ * @note Non chiude i descrittori registrati
+ */
+void free_event_loop(EventLoop* loop);
+
+/**
+ * Registra un descrittore nel ciclo di eventi
+ * @param loop EventLoop* ciclo di eventi
+ * @param fd descrittore da monitorare
+ * @param events maschera di eventi epoll (es. EPOLLIN)
+ * @param token valore restituito in data.u64 con gli eventi del descrittore
+ * @return true se la registrazione ha successo, false altrimenti
+ * @note Il token permette di riconoscere eventi rimasti per un descrittore
+ * chiuso e già riassegnato ad un'altra connessione
+ */
+bool event_loop_add(EventLoop* loop, int fd, uint32_t events, uint64_t token);
+
+/**
+ * Modifica gli eventi monitorati per un descrittore già registrato
+ * @param loop EventLoop* ciclo di eventi
+ * @param fd descrittore registrato
+ * @param events nuova maschera di eventi epoll
+ * @param token valore restituito in data.u64 con gli eventi del descrittore
+ * @return true se la modifica ha successo, false altrimenti
+ */
+bool event_loop_modify(EventLoop* loop, int fd, uint32_t events, uint64_t token);
+
+/**
+ * Rimuove un descrittore dal ciclo di eventi
+ * @param loop EventLoop* ciclo di eventi
+ * @param fd descrittore da rimuovere
+ */
+void event_loop_remove(EventLoop* loop, int fd);
+
+/**
+ * Attende che almeno un descrittore sia pronto
+ * @param loop EventLoop* ciclo di eventi
+ * @param timeout_ms tempo massimo di attesa in millisecondi (-1 per attesa infinita)
+ * @return numero di eventi pronti in loop->events, 0 allo scadere del timeout,
+ * -1 in caso di errore
+ * @note Un'interruzione da segnale (EINTR) viene riportata come 0 eventi
+ */
+int event_loop_wait(EventLoop* loop, int timeout_ms);
+
+#endif
@@ -0,0 +1,145 @@
+// Classifica ordinata di un quiz: un bucket per ogni punteggio possibile
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include "constants.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Punteggi possibili in un quiz: da 0 a QUESTIONS_PER_QUIZ
+#define LEADERBOARD_BUCKETS (QUESTIONS_PER_QUIZ + 1)
+
+/**
+ * Voce della classifica di un quiz
+ * @param nickname Nickname del giocatore
+ * @param score Punteggio del giocatore nel quiz
+ * @param prev Voce precedente con lo stesso punteggio (NULL se è la prima)
+ * @param next Voce successiva con lo stesso punteggio (NULL se è l'ultima)
+ * @param parent Genitore nell'albero posizionale del bucket (NULL per la radice)
+ * @param left Sottoalbero delle voci arrivate prima
+ * @param right Sottoalbero delle voci arrivate dopo
+ * @param size Numero di voci nel sottoalbero, compresa questa
+ * @param priority Priorità casuale che tiene bilanciato l'albero
+ * @note La voce appartiene al chiamante (il Player, che non cambia indirizzo)
+ * e punta al suo nickname: la classifica non alloca né copia nulla
+ */
+typedef struct LeaderboardNode {
+    const char* nickname;
+    int score;
+    struct LeaderboardNode* prev;
+    struct LeaderboardNode* next;
+    struct LeaderboardNode* parent;
+    struct LeaderboardNode* left;
+    struct LeaderboardNode* right;
+    int size;
+    uint32_t priority;
+} LeaderboardNode;
+
+/**
+ * Voci con lo stesso punteggio, nell'ordine in cui lo hanno raggiunto
+ * @param first Prima voce (NULL se il bucket è vuoto)
+ * @param last Ultima voce (NULL se il bucket è vuoto)
+ * @param root Radice del treap implicito delle voci, ordinato per arrivo
+ * @param count Numero di voci
+ * @note La lista serve a visitare le voci in ordine, il treap a raggiungere
+ * una posizione in O(log n) senza scorrere il bucket
+ */
+typedef struct {
+    LeaderboardNode* first;
+    LeaderboardNode* last;
+    LeaderboardNode* root;
+    int count;
+} LeaderboardBucket;
+
+/**
+ * Classifica di un quiz, ordinata per punteggio decrescente e, a pari
+ * punteggio, per ordine di arrivo a quel punteggio
+ * @param buckets Voci raggruppate per punteggio
+ * @param count Numero di voci
+ * @param seed Stato del generatore delle priorità
+ * @note Il punteggio di un quiz è limitato, quindi la posizione di un
+ * punteggio si ottiene sommando i bucket dei punteggi più alti, senza mai
+ * confrontare le voci. Un cambio di punteggio e l'accesso per posizione
+ * costano O(log n) attesi, per l'albero posizionale del bucket
+ */
+typedef struct {
+    LeaderboardBucket buckets[LEADERBOARD_BUCKETS];
+    int count;
+    uint32_t seed;
+} Leaderboard;
+
+/**
+ * Inizializza una classifica vuota
+ * @param board Leaderboard* da inizializzare
+ */
+void init_leaderboard(Leaderboard* board);
+
+/**
+ * Svuota la classifica senza toccare le voci, che appartengono ai chiamanti
+ * @param board Leaderboard* da svuotare
+ */
+void free_leaderboard(Leaderboard* board);
+
+/**
+ * Inserisce una voce in fondo ai pari merito
+ * @param board Leaderboard* di destinazione
+ * @param node voce da inserire, che deve restare allo stesso indirizzo finché è in classifica
+ * @param nickname nickname del giocatore, che deve vivere almeno quanto la voce
+ * @param score punteggio iniziale, da 0 a QUESTIONS_PER_QUIZ
+ * @return true se la voce è stata inserita, false se il punteggio è fuori intervallo
+ */
+bool leaderboard_insert(Leaderboard* board, LeaderboardNode* node, const char* nickname, int score);
+
+/**
+ * Rimuove una voce dalla classifica
+ * @param board Leaderboard* che contiene la voce
+ * @param node voce da rimuovere
+ */
+void leaderboard_remove(Leaderboard* board, LeaderboardNode* node);
+
+/**
+ * Cambia il punteggio di una voce, spostandola in fondo ai nuovi pari merito
+ * @param board Leaderboard* che contiene la voce
+ * @param node voce da aggiornare
+ * @param score nuovo punteggio, da 0 a QUESTIONS_PER_QUIZ
+ * @return true se la voce è stata aggiornata, false se il punteggio è fuori
+ * intervallo (la voce resta dov'è)
+ */
+bool leaderboard_update(Leaderboard* board, LeaderboardNode* node, int score);
+
+/**
+ * Restituisce la posizione in classifica di un punteggio
+ * @param board Leaderboard* in cui cercare
+ * @param score punteggio
+ * @return numero di voci con punteggio maggiore: i pari merito condividono
+ * la stessa posizione
+ */
+int leaderboard_rank(const Leaderboard* board, int score);
+
+/**
+ * Restituisce la voce in una posizione dell'elenco ordinato
+ * @param board Leaderboard* in cui cercare
+ * @param position posizione nell'elenco, a partire da 0
+ * @return voce in quella posizione, NULL se la posizione non esiste
+ * @note Costa O(LEADERBOARD_BUCKETS + log n) attesi. Le voci successive si
+ * ottengono con leaderboard_next()
+ */
+const LeaderboardNode* leaderboard_at(const Leaderboard* board, int position);
+
+/**
+ * Restituisce la voce che segue nell'elenco ordinato
+ * @param board Leaderboard* che contiene la voce
+ * @param node voce corrente
+ * @return voce successiva, NULL se node è l'ultima
+ */
+const LeaderboardNode* leaderboard_next(const Leaderboard* board, const LeaderboardNode* node);
+
+/**
+ * Restituisce la voce che precede nell'elenco ordinato
+ * @param board Leaderboard* che contiene la voce
+ * @param node voce corrente
+ * @return voce precedente, NULL se node è la prima
+ */
+const LeaderboardNode* leaderboard_prev(const Leaderboard* board, const LeaderboardNode* node);
+
+#endif
@@ -1,7 +1,10 @@
 #ifndef PLAYER_H
 #define PLAYER_H
 #include "constants.h"
+#include "leaderboard.h"
 #include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
 
 /**
  * Dati di un giocatore
@@ -11,31 +14,121 @@
  * @param completed_sport true se il giocatore ha completato il quiz sullo sport
  * @param completed_geography true se il giocatore ha completato il quiz sulla geografia
  * @param is_connected true se un client sta usando quel nickname, false altrimenti
+ * @param version Versione della classifica in cui il giocatore è cambiato l'ultima volta
+ * @param rankings Voci del giocatore nelle classifiche dei quiz Sport (0) e Geografia (1),
+ * contenute nel giocatore stesso
+ * @param hash Hash del nickname, calcolato una sola volta all'aggiunta
+ * @param slot Indice dello slot nelle pagine del registro
+ * @param generation Generazione corrente dello slot
+ * @param live_index Posizione del giocatore nell'elenco dei giocatori registrati
+ * @param next_free Slot libero successivo della stessa pagina (solo per gli slot liberi)
+ * @param older_change Giocatore modificato prima di questo (NULL se è il primo)
+ * @param newer_change Giocatore modificato dopo questo (NULL se è l'ultimo)
  */
-typedef struct {
+typedef struct Player {
     char nickname[MAX_NICK_LENGTH]; // Nickname del giocatore
     int sport_score; 
     int geography_score;
     bool completed_sport;
     bool completed_geography;
     bool is_connected;
+    uint32_t version;
+    LeaderboardNode rankings[2];
+    uint32_t hash;
+    int slot;
+    uint32_t generation;
+    int live_index;
+    int next_free;
+    struct Player* older_change;
+    struct Player* newer_change;
 } Player;
 
 /**
- * Array dinamico di giocatori
- * @param players Array di giocatori
- * @param count Numero di giocatori attualmente presenti nell'array
- * @param capacity Capacità massima dell'array
+ * Handle di un giocatore: slot nel registro nei 32 bit bassi, generazione nei 32 alti
+ * @note Il Player di uno slot non viene mai spostato, e la generazione cambia
+ * quando il giocatore viene rimosso: un handle conservato oltre la rimozione
+ * non raggiunge chi riusa lo slot
+ */
+typedef uint64_t PlayerHandle;
+
+// Handle che non corrisponde mai ad un giocatore (le generazioni partono da 1)
+#define INVALID_PLAYER_HANDLE 0
+
+/**
+ * Pagina di PLAYER_PAGE_SIZE giocatori del registro
+ * @param players Giocatori della pagina, NULL se la pagina è stata liberata
+ * @param live Numero di giocatori registrati nella pagina
+ * @param free_slot Primo slot libero della pagina (-1 se la pagina è piena)
+ * @param prev_free Pagina precedente con slot liberi (-1 se è la prima)
+ * @param next_free Pagina successiva con slot liberi o, per una pagina
+ * liberata, pagina liberata successiva (-1 se nessuna)
+ * @param generation Generazione da cui ripartono gli slot quando la pagina
+ * viene allocata di nuovo: la più alta raggiunta prima di liberarla
  */
 typedef struct {
     Player* players;
+    int live;
+    int free_slot;
+    int prev_free;
+    int next_free;
+    uint32_t generation;
+} PlayerPage;
+
+/**
+ * Registro dei giocatori
+ * @param pages Pagine di PLAYER_PAGE_SIZE giocatori: un Player non cambia mai indirizzo
+ * @param pages_count Numero di pagine, comprese quelle liberate
+ * @param pages_capacity Capacità di pages
+ * @param free_page Prima pagina con slot liberi (-1 se nessuna)
+ * @param released_page Prima pagina liberata, da riallocare prima di aggiungerne
+ * una nuova (-1 se nessuna)
+ * @param spare_page Pagina vuota tenuta come riserva (-1 se nessuna)
+ * @param live Slot dei giocatori registrati, i primi count sono validi
+ * @param live_capacity Capacità di live
+ * @param count Numero di giocatori registrati
+ * @param version Versione della classifica, incrementata ad ogni modifica
+ * di un nickname, punteggio o quiz completato
+ * @param reset_version Versione dell'ultima rimozione: i client con una versione
+ * precedente devono ricevere la classifica completa
+ * @param oldest_change Giocatore con la versione più bassa
+ * @param newest_change Giocatore con la versione più alta: risalendo da qui
+ * la classifica incrementale visita solo i giocatori cambiati
+ * @param leaderboards Classifiche ordinate dei quiz Sport (0) e Geografia (1)
+ * @param index Tabella hash a indirizzamento aperto (scansione lineare) dei nickname:
+ * ogni voce contiene lo slot di un giocatore nelle pagine, -1 se vuota
+ * @param index_capacity Numero di slot di index, sempre una potenza di 2
+ * @param lock Lock lettori/scrittori che protegge l'array quando è
+ * condiviso tra più worker del server
+ * @note Le funzioni di questo modulo non acquisiscono il lock: è compito
+ * del chiamante prenderlo attorno a ogni accesso ai giocatori
+ * @note Una pagina svuotata dalle rimozioni viene liberata, tranne una tenuta
+ * come riserva, quindi i record occupano memoria in proporzione ai giocatori
+ * registrati. live e index mantengono invece la capacità raggiunta nel momento
+ * di massimo, pochi byte per giocatore
+ */
+typedef struct {
+    PlayerPage* pages;
+    int pages_count;
+    int pages_capacity;
+    int free_page;
+    int released_page;
+    int spare_page;
+    int* live;
+    int live_capacity;
     int count;
-    int capacity;
+    uint32_t version;
+    uint32_t reset_version;
+    Player* oldest_change;
+    Player* newest_change;
+    Leaderboard leaderboards[2];
+    int* index;
+    int index_capacity;
+    pthread_rwlock_t lock;
 } PlayerArray;
 
 /**
  * Crea un array di giocatori vuoto
- * @param capacity capacità iniziale dell'array
+ * @param capacity numero di giocatori previsto, per dimensionare gli indici
  * @return PlayerArray*
  */
 PlayerArray* create_player_array(int capacity);
@@ -47,27 +140,94 @@ PlayerArray* create_player_array(int capacity);
  */
 void free_player_array(PlayerArray* array);
 
+/**
+ * Acquisisce il lock dell'array in lettura
+ * @param array PlayerArray* da bloccare
+ * @note Più lettori possono accedere contemporaneamente
+ */
+void lock_players_read(PlayerArray* array);
+
+/**
+ * Acquisisce il lock dell'array in scrittura
+ * @param array PlayerArray* da bloccare
+ * @note Necessario per ogni modifica ai giocatori
+ */
+void lock_players_write(PlayerArray* array);
+
+/**
+ * Rilascia il lock dell'array
+ * @param array PlayerArray* da sbloccare
+ */
+void unlock_players(PlayerArray* array);
+
 /**
  * Aggiunge un giocatore all'array
  * @param array PlayerArray* in cui aggiungere il giocatore
  * @param nickname const char* nickname del giocatore
- * @return true se il giocatore è stato aggiunto, false altrimenti
+ * @return Player* aggiunto, NULL se il nickname è già presente o l'allocazione fallisce
+ * @note Non c'è un numero massimo di giocatori: si alloca una nuova pagina solo
+ * quando non restano slot liberati da giocatori rimossi
  */
-bool add_player(PlayerArray* array, const char* nickname);
+Player* add_player(PlayerArray* array, const char* nickname);
 
 /**
- * Resetta i punteggi di un giocatore e setta il flag che
- * nessun client sta utilizzando quel nickname
+ * Restituisce un giocatore registrato
  * @param array PlayerArray* array di giocatori
- * @param nickname const char* nickname del giocatore
+ * @param i posizione nell'elenco dei giocatori registrati, da 0 a count - 1
+ * @return Player* giocatore
+ * @note L'elenco cambia ordine quando un giocatore viene rimosso
  */
-void reset_player_connection(PlayerArray* array, const char* nickname);
+Player* player_at(const PlayerArray* array, int i);
+
+/**
+ * Restituisce l'handle di un giocatore
+ * @param player giocatore
+ * @return handle valido finché il giocatore resta registrato
+ */
+PlayerHandle player_handle(const Player* player);
+
+/**
+ * Restituisce il giocatore identificato da un handle
+ * @param array PlayerArray* array di giocatori
+ * @param handle handle del giocatore
+ * @return Player* giocatore o NULL se è stato rimosso
+ */
+Player* lookup_player(PlayerArray* array, PlayerHandle handle);
+
+/**
+ * Registra una modifica alla voce di un giocatore nella classifica
+ * @param array PlayerArray* array di giocatori
+ * @param player Player* giocatore modificato
+ * @note Va chiamata con il lock in scrittura ad ogni cambio di punteggio o
+ * di quiz completati, così la classifica incrementale include il giocatore.
+ * Il giocatore passa in fondo all'elenco ordinato per versione in O(1)
+ */
+void touch_player(PlayerArray* array, Player* player);
+
+/**
+ * Assegna un punto al giocatore in un quiz
+ * @param array PlayerArray* array di giocatori
+ * @param player Player* giocatore che ha risposto correttamente
+ * @param sport_quiz true per il quiz sullo sport, false per la geografia
+ * @return true se il punto è stato assegnato, false se il giocatore ha già
+ * QUESTIONS_PER_QUIZ punti nel quiz
+ * @note Sposta il giocatore nel bucket del nuovo punteggio in O(log n) attesi
+ */
+bool add_point(PlayerArray* array, Player* player, bool sport_quiz);
+
+/**
+ * Setta il flag che nessun client sta utilizzando il nickname del giocatore
+ * @param player Player* giocatore
+ */
+void reset_player_connection(Player* player);
 
 /**
  * Rimuove un giocatore dall'array
  * @param array PlayerArray* da cui rimuovere il giocatore
  * @param nickname const char* nickname
  * @return true se il giocatore è stato rimosso, false altrimenti
+ * @note Se la pagina del giocatore resta vuota viene liberata, a meno che non
+ * diventi la pagina di riserva
  */
 bool remove_player(PlayerArray* array, const char* nickname);
 
@@ -76,36 +236,27 @@ bool remove_player(PlayerArray* array, const char* nickname);
  * @param array PlayerArray* in cui cercare il giocatore
  * @param nickname const char* nickname del giocatore da cercare
  * @return Player* al giocatore se trovato, NULL altrimenti 
+ * @note La ricerca passa dalla tabella hash dei nickname: il costo non
+ * dipende dal numero di giocatori registrati
  */
 Player* find_player(PlayerArray* array, const char* nickname);
 
-/**
- * Ordina i giocatori in base al punteggio
- * @param array PlayerArray* array di giocatori
- * @param sport_quiz true se si vuole ordinare i giocatori 
- * per il punteggio del quiz sullo sport, false per il quiz sulla geografia
-, l'array viene ordinato per riferimento
- */
-void sort_players_by_score(PlayerArray* array, bool sport_quiz);
-
 /**
  * Ritorna true se il giocatore ha completato il quiz richiesto
- * @param player Player* giocatore
- * @param nick_name const char* nickname del giocatore
+ * @param player Player* giocatore (NULL se non registrato)
  * @param sport_quiz true se si vuole verificare se il giocatore
  * ha completato il quiz sullo sport, false per la geografia
  * @return true se il giocatore ha completato il quiz richiesto, false altrimenti
  */
-bool has_completed_quiz(PlayerArray* player, const char* nick_name, bool sport_quiz);
+bool has_completed_quiz(const Player* player, bool sport_quiz);
 
 /**
  * Segna il quiz richiesto come completato per il giocatore
  * @param array PlayerArray* array di giocatori
- * @param nickname const char* nickname del giocatore
+ * @param player Player* giocatore (NULL se non registrato)
  * @param sport_quiz true se si vuole segnare il quiz sullo sport come completato,
  * false per la geografia
-
  */
-void mark_quiz_as_completed(PlayerArray* array, const char* nickname, bool sport_quiz);
+void mark_quiz_as_completed(PlayerArray* array, Player* player, bool sport_quiz);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,213 @@
+// Protocollo binario v2: codifica dell'header, payload strutturati e codici di stato
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "buffer.h"
+
+/*
+ * Versioni del protocollo
+ * v1: header {MessageType; uint32_t} copiato dalla memoria, payload testuali
+ * v2: header [tipo u8][flag u8][lunghezza varint], payload strutturati
+ *
+ * Negoziazione: il client invia MSG_LOGIN in framing v1 con un byte di payload
+ * contenente la versione più alta che supporta, e non invia altro finché non
+ * riceve risposta. Un server v2 risponde con MSG_VERSION (ancora in framing v1)
+ * e da quel momento entrambi usano la versione indicata; un server v1 ignora il
+ * payload e risponde direttamente con MSG_NICKNAME_PROMPT.
+ */
+#define PROTOCOL_VERSION_LEGACY 1
+#define PROTOCOL_VERSION 2
+
+/*
+ * MSG_ANSWER_NEXT (solo v2) sostituisce la coppia MSG_ANSWER_RESULT e messaggio
+ * successivo (domanda, quiz completato o trivia completato) inviata dopo ogni
+ * risposta: [codice di stato u8][tipo del messaggio successivo u8][suo payload v2]
+ */
+
+/*
+ * MSG_ERROR (v2): [codice di stato u8]. Risponde ad una richiesta che il server
+ * non può soddisfare, così il client non resta in attesa di una risposta
+ */
+
+// Flag dell'header v2: il messaggio prosegue nel messaggio successivo, dello stesso
+// tipo (usato per inviare la classifica a pezzi di SCOREBOARD_CHUNK_SIZE byte)
+#define MSG_FLAG_MORE 0x01
+
+// Dimensione massima di un header v2: tipo, flag e varint di 5 byte
+#define PROTOCOL_MAX_HEADER_SIZE 7
+
+// Quiz disponibili nel payload v2 di MSG_QUIZ_AVAILABLE
+#define QUIZ_MASK_SPORT 0x01
+#define QUIZ_MASK_GEOGRAPHY 0x02
+
+// Classifica v2 completa: sostituisce quella conservata dal client
+#define SCOREBOARD_FULL 0x01
+
+/*
+ * MSG_REQUEST_SCORE v2: [versione della classifica conservata varint], seguita
+ * facoltativamente da [quiz u8][posizione iniziale varint][numero voci varint]
+ * [flag u8] per chiedere una sola pagina della classifica di un quiz (1 Sport,
+ * 2 Geografia). La pagina arriva in MSG_SCORE_PAGE:
+ * [quiz u8][flag u8][voci in classifica varint][posizione iniziale varint]
+ * [numero voci varint], poi per ogni voce [nickname stringa][punteggio varint];
+ * con SCORE_QUERY_MY_RANK segue [posizione del richiedente varint][suo
+ * punteggio varint]. La posizione iniziale parte da 0, quella del richiedente
+ * da 1 (0 se non è in classifica) ed è condivisa con i pari merito.
+ */
+#define SCORE_QUERY_MY_RANK 0x01
+
+// Voci massime di una pagina della classifica
+#define SCORE_PAGE_MAX_ENTRIES 50
+
+/*
+ * MSG_REQUEST_RANK v2: [quiz u8] (1 Sport, 2 Geografia). La risposta arriva in
+ * MSG_RANK: [quiz u8][voci in classifica varint][posizione del richiedente
+ * varint][suo punteggio varint], poi [numero voci precedenti varint] e
+ * [numero voci successive varint], ognuna seguita dalle sue voci in ordine di
+ * classifica come [posizione varint][nickname stringa][punteggio varint].
+ * Le posizioni partono da 1 e sono condivise dai pari merito; se il
+ * richiedente non è in classifica la sua posizione è 0 e non ci sono voci vicine.
+ */
+
+// Voci vicine inviate in MSG_RANK, sia prima che dopo il richiedente
+#define RANK_NEIGHBOURS 2
+
+// Quiz completati da un giocatore nel payload v2 della classifica
+#define SCORE_FLAG_COMPLETED_SPORT 0x01
+#define SCORE_FLAG_COMPLETED_GEOGRAPHY 0x02
+
+/**
+ * Codici di stato inviati al posto dei testi nei payload v2
+ * @note Il testo corrispondente si ottiene con status_text(): il server lo
+ * invia ai client v1, i client v2 lo ricostruiscono dal codice
+ */
+typedef enum {
+    STATUS_NICKNAME_PROMPT = 1,     // Richiesta di inserire il nickname
+    STATUS_LOGIN_NEW,               // Login di un nuovo giocatore
+    STATUS_LOGIN_RETURNING,         // Login di un giocatore già registrato
+    STATUS_LOGIN_ALL_COMPLETED,     // Il giocatore ha già completato tutti i quiz
+    STATUS_LOGIN_NICKNAME_IN_USE,   // Nickname usato da un altro client
+    STATUS_LOGIN_SERVER_FULL,       // Memoria esaurita nel registro dei giocatori
+    STATUS_ANSWER_WRONG,            // Risposta errata
+    STATUS_ANSWER_CORRECT,          // Risposta corretta
+    STATUS_QUIZ_COMPLETED,          // Quiz completato
+    STATUS_QUIZ_ENDED,              // Quiz abbandonato con endquiz
+    STATUS_QUIZ_UNAVAILABLE,        // Quiz selezionato non disponibile
+    STATUS_TRIVIA_COMPLETED,        // Completati tutti i quiz
+    STATUS_SERVER_SHUTDOWN,         // Il server sta terminando
+    STATUS_QUIZ_IN_PROGRESS,        // Selezione di un quiz con un quiz già in corso
+    STATUS_REQUEST_FAILED,          // Richiesta non valida o risposta non costruibile
+    STATUS_COUNT                    // Numero di codici, non è un codice valido
+} StatusCode;
+
+/**
+ * Cursore per la lettura di un payload v2
+ * @param data byte del payload
+ * @param length numero di byte del payload
+ * @param offset byte già letti
+ * @param error true se una lettura ha superato la fine del payload
+ * @note Dopo un errore le letture restituiscono valori nulli: basta
+ * controllare error al termine della decodifica
+ */
+typedef struct {
+    const char* data;
+    size_t length;
+    size_t offset;
+    bool error;
+} PayloadReader;
+
+/**
+ * Restituisce il testo associato ad un codice di stato
+ * @param code codice di stato
+ * @return testo del messaggio, "" per codici sconosciuti
+ */
+const char* status_text(StatusCode code);
+
+/**
+ * Codifica un intero senza segno come varint (7 bit per byte, little endian)
+ * @param value valore da codificare
+ * @param out buffer di destinazione, grande almeno 5 byte
+ * @return numero di byte scritti
+ */
+size_t encode_varint(uint32_t value, char* out);
+
+/**
+ * Decodifica un varint
+ * @param data byte disponibili
+ * @param length numero di byte disponibili
+ * @param value destinazione del valore decodificato
+ * @return byte consumati, 0 se il varint non è ancora completo,
+ * -1 se è più lungo di 5 byte
+ */
+int decode_varint(const char* data, size_t length, uint32_t* value);
+
+/**
+ * Codifica l'header v2 di un messaggio
+ * @param type tipo del messaggio
+ * @param flags flag dell'header (es. MSG_FLAG_MORE)
+ * @param length lunghezza del payload
+ * @param out buffer di destinazione, grande almeno PROTOCOL_MAX_HEADER_SIZE
+ * @return numero di byte scritti
+ */
+size_t encode_header_v2(uint8_t type, uint8_t flags, uint32_t length, char* out);
+
+/**
+ * Aggiunge un byte ad un payload v2
+ * @param buffer ByteBuffer* di destinazione
+ * @param value byte da aggiungere
+ * @return true se il byte è stato aggiunto, false se l'allocazione fallisce
+ */
+bool append_u8(ByteBuffer* buffer, uint8_t value);
+
+/**
+ * Aggiunge un varint ad un payload v2
+ * @param buffer ByteBuffer* di destinazione
+ * @param value valore da aggiungere
+ * @return true se il valore è stato aggiunto, false se l'allocazione fallisce
+ */
+bool append_varint(ByteBuffer* buffer, uint32_t value);
+
+/**
+ * Aggiunge una stringa ad un payload v2, preceduta dalla sua lunghezza in varint
+ * @param buffer ByteBuffer* di destinazione
+ * @param text stringa da aggiungere
+ * @param length lunghezza della stringa
+ * @return true se la stringa è stata aggiunta, false se l'allocazione fallisce
+ */
+bool append_string(ByteBuffer* buffer, const char* text, size_t length);
+
+/**
+ * Inizializza un cursore di lettura su un payload
+ * @param reader PayloadReader* da inizializzare
+ * @param data byte del payload
+ * @param length numero di byte del payload
+ */
+void init_payload_reader(PayloadReader* reader, const char* data, size_t length);
+
+/**
+ * Legge un byte
+ * @param reader PayloadReader* cursore
+ * @return byte letto, 0 se il payload è terminato
+ */
+uint8_t read_u8(PayloadReader* reader);
+
+/**
+ * Legge un varint
+ * @param reader PayloadReader* cursore
+ * @return valore letto, 0 se il payload è terminato o il varint non è valido
+ */
+uint32_t read_varint(PayloadReader* reader);
+
+/**
+ * Legge una stringa preceduta dalla sua lunghezza
+ * @param reader PayloadReader* cursore
+ * @param length destinazione della lunghezza della stringa
+ * @return puntatore ai byte della stringa dentro il payload (non terminata
+ * da '\0'), NULL se il payload è terminato
+ */
+const char* read_string(PayloadReader* reader, size_t* length);
+
+#endif
@@ -4,10 +4,133 @@
 #include "server.h"
 
 /**
- * Formatta i punteggi di tutti i giocatori in una stringa
+ * Formati della classifica completa conservati nella cache
+ * @param SCOREBOARD_TEXT Testo di format_scores() per i client v1 e la console
+ * @param SCOREBOARD_V2 Payload di encode_scores() per i client v2
+ */
+typedef enum {
+    SCOREBOARD_TEXT,
+    SCOREBOARD_V2,
+    SCOREBOARD_FORMATS
+} ScoreboardFormat;
+
+/**
+ * Classifica completa già prodotta, condivisa tra le richieste e tra i worker
+ * @param refs Riferimenti attivi: la cache e ogni richiesta che la sta inviando
+ * @param players Array di giocatori da cui è stata prodotta
+ * @param version Versione della classifica al momento della produzione
+ * @param data Testo o payload della classifica
+ * @note Il contenuto non cambia mai: una nuova versione produce una nuova
+ * voce, e la precedente viene liberata quando l'ultimo riferimento la rilascia
+ */
+typedef struct RenderedScoreboard {
+    int refs;
+    const PlayerArray* players;
+    uint32_t version;
+    ByteBuffer data;
+} RenderedScoreboard;
+
+/**
+ * Formatta i punteggi di tutti i giocatori in testo
+ * @param state struttura ServerState contenente i giocatori
+ * @param out ByteBuffer* in cui aggiungere il testo
+ * @return true se il testo è stato aggiunto, false se l'allocazione fallisce
+ * @note Le classifiche dei quiz sono già ordinate, quindi basta il lock
+ * dei giocatori in lettura
+ */
+bool format_scores(ServerState* state, ByteBuffer* out);
+
+/**
+ * Codifica la classifica completa nel payload v2
+ * @param state struttura ServerState contenente i giocatori
+ * @param out ByteBuffer* in cui aggiungere il payload
+ * @return true se il payload è stato codificato, false se l'allocazione fallisce
+ * @note Formato: [versione varint][SCOREBOARD_FULL o 0 u8][numero voci varint],
+ * poi per ogni voce [nickname stringa][punteggio sport varint]
+ * [punteggio geografia varint][flag u8] con i flag SCORE_FLAG_*
+ * @note L'ordinamento e il testo sono lasciati al client, quindi basta il lock
+ * dei giocatori in lettura. Il payload cresce con i giocatori: viene prodotto
+ * solo per la cache e inviato a pezzi
+ */
+bool encode_scores(ServerState* state, ByteBuffer* out);
+
+/**
+ * Codifica le sole voci cambiate dopo una versione nel payload v2
+ * @param state struttura ServerState contenente i giocatori
+ * @param since ultima versione della classifica nota al client
+ * @param max_length byte massimi del payload
+ * @param out ByteBuffer* in cui aggiungere il payload
+ * @return true se il payload è stato codificato, false se since non è
+ * utilizzabile, se sono cambiate più di metà delle voci, se il payload
+ * supererebbe max_length o se l'allocazione fallisce: in tutti i casi il
+ * chiamante invia la classifica completa
+ * @note Stesso formato di encode_scores(), senza SCOREBOARD_FULL. Le voci
+ * cambiate si trovano in O(voci cambiate) dall'elenco dei giocatori ordinato
+ * per versione, e il limite viene verificato prima di codificarle. Basta il
+ * lock dei giocatori in lettura
+ */
+bool encode_score_delta(ServerState* state, uint32_t since, size_t max_length, ByteBuffer* out);
+
+/**
+ * Codifica una pagina della classifica di un quiz nel payload v2
+ * @param state struttura ServerState contenente i giocatori
+ * @param player handle del richiedente, di cui inviare la posizione
+ * @param quiz quiz della classifica (1 Sport, 2 Geografia)
+ * @param offset posizione della prima voce, a partire da 0
+ * @param limit numero massimo di voci, ridotto a SCORE_PAGE_MAX_ENTRIES
+ * @param flags flag della richiesta (SCORE_QUERY_MY_RANK)
+ * @param out ByteBuffer* in cui aggiungere il payload
+ * @return true se il payload è stato codificato, false se il quiz non
+ * esiste o l'allocazione fallisce
+ * @note Il formato è descritto in protocol.h. La prima voce si raggiunge in
+ * O(QUESTIONS_PER_QUIZ + log n) attesi e le successive in O(1) ciascuna,
+ * quindi basta il lock dei giocatori in lettura
+ */
+bool encode_score_page(ServerState* state, PlayerHandle player, uint8_t quiz,
+                       uint32_t offset, uint32_t limit, uint8_t flags, ByteBuffer* out);
+
+/**
+ * Codifica la posizione di un giocatore in un quiz nel payload v2
+ * @param state struttura ServerState contenente i giocatori
+ * @param player handle del giocatore
+ * @param quiz quiz della classifica (1 Sport, 2 Geografia)
+ * @param out ByteBuffer* in cui aggiungere il payload
+ * @return true se il payload è stato codificato, false se il quiz non
+ * esiste o l'allocazione fallisce
+ * @note Il formato è descritto in protocol.h. La posizione si ricava dai
+ * bucket dei punteggi e le voci vicine dai collegamenti della voce del
+ * giocatore: la classifica non viene né scorsa né prodotta. Basta il lock
+ * dei giocatori in lettura
+ */
+bool encode_player_rank(ServerState* state, PlayerHandle player, uint8_t quiz, ByteBuffer* out);
+
+/**
+ * Restituisce la classifica completa nel formato richiesto, producendola
+ * solo se i giocatori sono cambiati dall'ultima volta
  * @param state struttura ServerState contenente i giocatori
- * @return puntatore a stringa formattata con i punteggi
+ * @param format formato della classifica
+ * @return RenderedScoreboard* da rilasciare con release_scoreboard(),
+ * NULL se l'allocazione fallisce
+ * @note La validità è decisa dalla versione dei giocatori, incrementata da
+ * ogni nuovo giocatore, punto o quiz completato. La cache resta bloccata solo
+ * per prendere o sostituire un riferimento: la produzione avviene fuori, una
+ * per formato alla volta, e le richieste che trovano la classifica aggiornata
+ * non la attendono
+ * @note Acquisisce il lock dei giocatori in lettura: non va chiamata
+ * mentre lo si possiede già
+ */
+const RenderedScoreboard* acquire_scoreboard(ServerState* state, ScoreboardFormat format);
+
+/**
+ * Rilascia una classifica ottenuta con acquire_scoreboard()
+ * @param board classifica da rilasciare
+ */
+void release_scoreboard(const RenderedScoreboard* board);
+
+/**
+ * Libera le classifiche conservate nella cache
+ * @note Va chiamata dopo la terminazione dei worker
  */
-char* format_scores(ServerState* state);
+void free_scoreboard_cache();
 
 #endif
\ No newline at end of file
@@ -1,100 +1,462 @@
 #ifndef SERVER_H
 #define SERVER_H
 
-#include <sys/select.h>
 #include "common.h"
 #include "player.h"
 #include "quiz.h"
 #include "debug.h"
+#include "event_loop.h"
+#include "buffer.h"
+#include "uring.h"
+#include "timer_wheel.h"
 
 /**
- * Struttura per mantenere lo stato del server
- * @param server_socket Socket del server
- * @param active_fds Set di descrittori attivi
- * @param read_fds Set di descrittori in lettura
- * @param max_fd Massimo indice tra i descrittori attivi
- * @param players Array di giocatori
+ * Motore di I/O usato dai worker
+ * @param ENGINE_EPOLL Readiness con epoll e recv/send sincrone
+ * @param ENGINE_URING Completion con io_uring: accept, recv e send
+ * vengono sottomesse al kernel e completate in modo asincrono
+ */
+typedef enum {
+    ENGINE_EPOLL,
+    ENGINE_URING
+} IoEngine;
+
+/**
+ * Configurazione del server letta dalla riga di comando
+ * @param port Porta su cui mettersi in ascolto
+ * @param workers Numero di thread worker
+ * @param engine Motore di I/O richiesto
+ * @param backlog Lunghezza della coda delle connessioni in attesa di accept
+ * @param output_high_water Byte in uscita accodati tollerati per ogni client
+ * @note È condivisa in sola lettura da tutti i worker
  */
 typedef struct {
-    int server_socket;
-    fd_set active_fds;
-    fd_set read_fds;
-    int max_fd;
-    PlayerArray* players;
-} ServerState;
+    int port;
+    int workers;
+    IoEngine engine;
+    int backlog;
+    size_t output_high_water;
+} ServerConfig;
+
+/**
+ * Stato di una connessione gestita dal motore io_uring
+ * @param fd Socket del client
+ * @param refs Riferimenti attivi: il client e ogni operazione in volo
+ * @param closed true dopo la disconnessione, in attesa degli ultimi completamenti
+ * @param dirty true se la connessione è nella lista delle send da sottomettere
+ * @param pending Messaggi accodati in attesa della prossima send
+ * @param inflight Byte della send attualmente in volo (vuoto se nessuna)
+ * @param inflight_sent Byte di inflight già confermati dal kernel
+ * @param prev Connessione precedente nella lista del worker
+ * @param next Connessione successiva nella lista del worker
+ * @note La struttura sopravvive alla chiusura del socket finché il kernel
+ * non ha restituito il completamento di tutte le operazioni che la riferiscono
+ */
+typedef struct UringConnection {
+    int fd;
+    int refs;
+    bool closed;
+    bool dirty;
+    ByteBuffer pending;
+    ByteBuffer inflight;
+    size_t inflight_sent;
+    struct UringConnection* prev;
+    struct UringConnection* next;
+} UringConnection;
+
+/**
+ * Handle di un client: slot nel slab nei 32 bit bassi, generazione nei 32 alti
+ * @note La generazione di uno slot cambia ad ogni disconnessione, quindi un
+ * handle conservato oltre la vita del client non raggiunge chi riusa lo slot
+ */
+typedef uint64_t ClientHandle;
+
+// Handle che non corrisponde mai ad un client (le generazioni partono da 1)
+#define INVALID_CLIENT_HANDLE 0
+
+/**
+ * Messaggio codificato una sola volta, pronto per essere accodato così com'è
+ * @param data header e payload del messaggio
+ * @param length numero di byte del frame
+ */
+typedef struct {
+    char data[sizeof(NetworkHeader) + MAX_MSG_LEN];
+    size_t length;
+} StaticFrame;
 
 /**
  * Struttura per mantenere lo stato del client
+ * @param is_connected true se lo slot è associato ad un socket aperto
+ * @param protocol Versione del protocollo negoziata con il client
+ * @param fd Socket del client
+ * @param slot Indice dello slot nel slab dei client
+ * @param generation Generazione corrente dello slot
+ * @param live_index Posizione del client nell'elenco dei client connessi
+ * @param next_free Slot libero successivo (solo per gli slot liberi)
  * @param nickname Nickname del giocatore scelto dal client
+ * @param player Handle del giocatore, ottenuto al login (INVALID_PLAYER_HANDLE prima del login)
  * @param current_quiz Numero del quiz attualmente selezionato (1 per sport, 2 per geografia)
  * @param current_question Numero della domanda corrente
  * @param is_playing Indica se il client è attualmente in partita
  * @param selected_question_indices Indici delle domande selezionate per il quiz
+ * @param input Byte ricevuti e non ancora ricomposti in messaggi
+ * @param output Byte in attesa che il socket torni scrivibile (motore epoll)
+ * @param waiting_writable true se il socket è monitorato per EPOLLOUT
+ * @param output_dirty true se il client è nella lista dei client da svuotare
+ * @param send_failed true se un invio è fallito o la coda in uscita ha superato
+ * il limite: il client viene disconnesso al termine della richiesta corrente
+ * @param input_ready true se il client è nella lista dei client con messaggi
+ * completi rimasti nel buffer dopo aver esaurito MAX_FRAMES_PER_EVENT
+ * @param uring_conn Connessione io_uring associata, NULL con il motore epoll
+ * @param timer Timer della prossima scadenza del client (login, inattività o messaggio incompleto)
+ * @param connected_at Istante della connessione, per la scadenza del login
+ * @param last_activity Istante dell'ultima ricezione di dati
+ * @param partial_since Istante da cui nel buffer di input c'è un messaggio incompleto (0 se nessuno)
+ * @param pending_result Esito dell'ultima risposta ancora da inviare insieme al
+ * messaggio successivo in un MSG_ANSWER_NEXT (0 se nessuno, solo client v2)
+ * @param stream Classifica in corso di invio a pezzi (NULL se nessuna): finché
+ * non è stata accodata per intero le richieste del client restano sospese
+ * @param stream_offset Byte di stream già accodati
+ * @param stream_type Tipo del messaggio con cui viene inviata stream
  */
 typedef struct {
+    bool is_connected;
+    int protocol;
+    int fd;
+    int slot;
+    uint32_t generation;
+    int live_index;
+    int next_free;
     char nickname[MAX_NICK_LENGTH];
+    PlayerHandle player;
     int current_quiz;
     int current_question;
     bool is_playing;
     int selected_question_indices[QUESTIONS_PER_QUIZ];
+    ByteBuffer input;
+    ByteBuffer output;
+    bool waiting_writable;
+    bool output_dirty;
+    bool send_failed;
+    bool input_ready;
+    UringConnection* uring_conn;
+    Timer timer;
+    uint64_t connected_at;
+    uint64_t last_activity;
+    uint64_t partial_since;
+    uint8_t pending_result;
+    const struct RenderedScoreboard* stream;
+    size_t stream_offset;
+    MessageType stream_type;
 } ClientData;
 
+/**
+ * Struttura per mantenere lo stato di un worker del server
+ * @param server_socket Socket di ascolto del worker
+ * @param wakeup_fd eventfd usato dal thread principale per richiedere lo shutdown
+ * @param loop Ciclo di eventi (epoll) su cui sono registrati i socket del worker
+ * @param client_pages Pagine del slab dei client: i ClientData non vengono mai spostati
+ * @param client_pages_count Numero di pagine allocate
+ * @param free_client_slot Primo slot libero del slab (-1 se nessuno)
+ * @param live_clients Slot dei client connessi, i primi client_count sono validi
+ * @param live_clients_capacity Capacità di live_clients
+ * @param client_count Numero di client attualmente connessi al worker
+ * @param fd_slots Slot del client associato ad ogni socket, più uno (0 se nessuno)
+ * @param fd_slots_capacity Numero di socket coperti da fd_slots
+ * @param players Array di giocatori, condiviso tra tutti i worker
+ * @param config Configurazione del server, condivisa tra tutti i worker
+ * @param engine Motore di I/O del worker
+ * @param ring Istanza io_uring (solo con ENGINE_URING)
+ * @param uring_connections Connessioni io_uring ancora referenziate dal kernel
+ * @param dirty_connections Connessioni con messaggi da sottomettere
+ * @param dirty_count Numero di connessioni in dirty_connections
+ * @param dirty_capacity Capacità di dirty_connections
+ * @param dirty_clients Handle dei client con risposte accodate nell'iterazione (motore epoll)
+ * @param dirty_clients_count Numero di handle in dirty_clients
+ * @param dirty_clients_capacity Capacità di dirty_clients
+ * @param ready_clients Handle dei client con messaggi ancora da elaborare
+ * @param ready_clients_count Numero di handle in ready_clients
+ * @param ready_clients_capacity Capacità di ready_clients
+ * @param timers Timer wheel con le scadenze dei client del worker
+ * @param now_ms Tempo monotono letto all'ultimo risveglio del ciclo di eventi
+ * @param wakeup_value Destinazione della read sul wakeup_fd (motore io_uring)
+ * @param scratch Buffer in cui le risposte vengono costruite prima di essere accodate:
+ * resta allocato tra una richiesta e l'altra
+ * @note Con un solo worker il comportamento è quello del server single-thread
+ */
+typedef struct {
+    int server_socket;
+    int wakeup_fd;
+    EventLoop* loop;
+    ClientData** client_pages;
+    int client_pages_count;
+    int free_client_slot;
+    int* live_clients;
+    int live_clients_capacity;
+    int client_count;
+    int* fd_slots;
+    int fd_slots_capacity;
+    PlayerArray* players;
+    const ServerConfig* config;
+    IoEngine engine;
+    IoUring* ring;
+    UringConnection* uring_connections;
+    UringConnection** dirty_connections;
+    int dirty_count;
+    int dirty_capacity;
+    ClientHandle* dirty_clients;
+    int dirty_clients_count;
+    int dirty_clients_capacity;
+    ClientHandle* ready_clients;
+    int ready_clients_count;
+    int ready_clients_capacity;
+    TimerWheel* timers;
+    uint64_t now_ms;
+    uint64_t wakeup_value;
+    ByteBuffer scratch;
+} ServerState;
+
 // Funzioni server
 
 /**
  * Inizializza il socket del server
  * @param state ServerState* struttura del server
  * @param ip indirizzo ip del server
- * @param port porta del server
+ * @param config configurazione con porta e backlog; con più worker viene
+ * abilitato SO_REUSEPORT per condividere la porta
  * @return true se l'inizializzazione ha successo, false altrimenti
+ * @note Il socket di ascolto è non bloccante, così da poter svuotare
+ * la coda delle connessioni in attesa con accept ripetute
  */
-bool init_server_socket(ServerState* state, const char* ip, int port);
+bool init_server_socket(ServerState* state, const char* ip, const ServerConfig* config);
 
 /**
- * Inizializza il server e le sue strutture dati
+ * Inizializza un worker del server e le sue strutture dati
  * @param ip indirizzo ip del server    
- * @param port porta del server
- * @note Inizializza i set di file descriptor select().
- * Inizializza read, write e error set
- * @return Restituisce la struttura ServerState inizializzata
+ * @param config configurazione del server, deve restare valida per tutta la vita del worker
+ * @param players array di giocatori condiviso tra i worker
+ * @note Il motore di I/O è quello indicato da config->engine.
+ * Con ENGINE_EPOLL crea il ciclo di eventi e vi registra il socket di ascolto,
+ * con ENGINE_URING crea l'istanza io_uring e i buffer per le recv
+ * @return Restituisce la struttura ServerState inizializzata, NULL in caso di errore
  */
-ServerState* init_server(const char* ip, int port);
+ServerState* init_server(const char* ip, const ServerConfig* config, PlayerArray* players);
 
 /**
  * Inizializza i dati del client
+ * @param state ServerState* worker che gestisce il client
  * @param client_socket socket del client
+ * @return true se lo slot del client è disponibile, false se non è stato
+ * possibile allargare la tabella dei client
  * @note Inizializza i dati del client con valori di default 
  * e imposta is_playing = false per indicare che il client non è in partita
+ * @note Programma la scadenza del login: un client che non lo completa
+ * entro LOGIN_TIMEOUT_MS viene disconnesso
+ */
+bool init_client_data(ServerState* state, int client_socket);
+
+/**
+ * Libera le risorse associate ai dati di un client e ne restituisce lo slot al slab
+ * @param state ServerState* worker che gestisce il client
+ * @param client_socket socket del client
+ * @note Non chiude il socket; gli handle del client smettono di essere validi
+ */
+void release_client_data(ServerState* state, int client_socket);
+
+/**
+ * Restituisce i dati del client associato ad un socket
+ * @param state ServerState* worker che gestisce il client
+ * @param client_socket socket del client
+ * @return ClientData* del client o NULL se il socket non appartiene ad un client
+ */
+ClientData* get_client(ServerState* state, int client_socket);
+
+/**
+ * Restituisce i dati del client identificato da un handle
+ * @param state ServerState* worker che gestisce il client
+ * @param handle handle del client
+ * @return ClientData* del client o NULL se il client si è disconnesso
+ */
+ClientData* lookup_client(ServerState* state, ClientHandle handle);
+
+/**
+ * Restituisce l'handle di un client
+ * @param client dati del client
+ * @return handle valido finché il client resta connesso
+ */
+ClientHandle client_handle(const ClientData* client);
+
+/**
+ * Riprogramma il timer di un client sulla sua prossima scadenza
+ * @param state ServerState* worker che gestisce il client
+ * @param client_socket socket del client
+ */
+void schedule_client_timer(ServerState* state, int client_socket);
+
+/**
+ * Gestisce la scadenza del timer di un client
+ * @param timer Timer* scaduto, il suo owner è l'handle del client
+ * @param ctx ServerState* worker che gestisce il client
+ * @note Le scadenze vengono ricalcolate qui: ricevere dati non sposta il
+ * timer, che al risveglio viene riprogrammato se il client è ancora attivo
  */
-void init_client_data(int client_socket);
+void handle_client_timer(Timer* timer, void* ctx);
 
 /**
- * Pulisce le risorse allocate dal server
+ * Pulisce le risorse allocate da un worker del server
  * @param state ServerState* struttura del server
 
- * @note Chiude tutti i socket aperti
+ * @note Chiude tutti i socket aperti del worker. L'array dei giocatori
+ * condiviso e i quiz vengono liberati dal thread principale
  */
 void cleanup_server(ServerState* state);
 
 /**
- * Aggiorna l'indice del massimo descrittore attivo (max_fd)
- * @param state ServerState* struttura del server
+ * Alza il limite dei file descriptor aperti del processo fino al massimo consentito
+ * @note Senza il tetto di FD_SETSIZE di select() il numero di client
+ * contemporanei è limitato solo da RLIMIT_NOFILE
  */
-void update_max_fd(ServerState* state);
+void raise_fd_limit();
 
 /**
- * Gestisce una nuova connessione in arrivo
+ * Accetta tutte le connessioni in attesa sul socket di ascolto
  * @param state ServerState* struttura del server
+ * @note Le connessioni vengono accettate con accept4() finché la coda non è
+ * vuota, così un picco di connessioni richiede un solo risveglio del worker
  */
 void handle_new_connection(ServerState* state);
 
 /**
- * Gestisce un messaggio ricevuto da un client
+ * Stampa l'indirizzo di un client appena connesso
+ * @param client_addr indirizzo del client
+ * @note Solo nelle build di debug: in produzione una riga per connessione
+ * rallenterebbe l'accept durante i picchi di connessioni
+ */
+void print_client_address(const struct sockaddr_in* client_addr);
+
+/**
+ * Legge i byte disponibili sul socket di un client ed elabora i messaggi completi
  * @param state ServerState* struttura del server
- * @param client_socket socket del client
+ * @param client_socket socket del client, in modalità non bloccante
+ * @note Un client che invia un messaggio a pezzi non blocca il worker:
+ * i byte restano nel suo buffer di input finché il messaggio non è completo
  */
 void process_client_message(ServerState* state, int client_socket);
 
+/**
+ * Ricompone ed elabora i messaggi completi presenti nel buffer di input del client
+ * @param state ServerState* struttura del server
+ * @param client_socket socket del client
+ * @note I byte di un messaggio incompleto restano nel buffer fino alla ricezione successiva
+ * @note Vengono elaborati al più MAX_FRAMES_PER_EVENT messaggi: il resto viene
+ * ripreso da process_ready_clients(), dopo gli eventi degli altri client
+ */
+void process_input_buffer(ServerState* state, int client_socket);
+
+/**
+ * Riprende l'elaborazione dei client che hanno esaurito il budget di messaggi
+ * @param state ServerState* struttura del server
+ * @note Ogni client elabora un altro blocco di MAX_FRAMES_PER_EVENT messaggi;
+ * chi ne ha ancora torna in lista per l'iterazione successiva
+ */
+void process_ready_clients(ServerState* state);
+
+/**
+ * Esegue la richiesta contenuta in un messaggio ricevuto da un client
+ * @param state ServerState* struttura del server
+ * @param client_socket socket del client
+ * @param message Message* messaggio ricevuto, il payload resta del chiamante
+ * @note Il payload è terminato da '\0' e, quando arriva da process_input_buffer(),
+ * punta direttamente nel buffer di input: è valido solo durante la chiamata
+ */
+void dispatch_client_message(ServerState* state, int client_socket, Message* message);
+
+/**
+ * Invia un messaggio ad un client con il motore di I/O del worker
+ * @param state ServerState* struttura del server
+ * @param client_socket socket del client
+ * @param msg Message* messaggio da inviare
+ * @return numero di byte inviati o accodati, ERR_SEND in caso di errore
+ * @note Il messaggio viene sempre copiato nella coda in uscita del client,
+ * quindi il chiamante può liberare subito il payload
+ * @note Se i byte in coda superano config->output_high_water il client è considerato
+ * troppo lento: l'invio fallisce e il client viene disconnesso
+ */
+ssize_t send_to_client(ServerState* state, int client_socket, Message* msg);
+
+/**
+ * Invia ad un client un frame già codificato
+ * @param state ServerState* struttura del server
+ * @param client_socket socket del client
+ * @param frame StaticFrame* frame da inviare, codificato per il protocollo del client
+ * @return numero di byte accodati, ERR_SEND in caso di errore
+ * @note Come send_to_client(), ma senza codificare l'header
+ */
+ssize_t send_frame_to_client(ServerState* state, int client_socket, const StaticFrame* frame);
+
+/**
+ * Accoda header e payload di un messaggio nel buffer in uscita di un client
+ * @param state ServerState* struttura del server
+ * @param client_socket socket del client
+ * @param header byte dell'header già codificato
+ * @param header_size numero di byte di header
+ * @param payload byte del payload, NULL se nessuno
+ * @param length numero di byte di payload
+ * @return numero di byte accodati, ERR_SEND in caso di errore
+ * @note L'invio avviene in flush_dirty_clients() al termine dell'iterazione
+ */
+ssize_t queue_client_output(ServerState* state, int client_socket, const char* header,
+                            size_t header_size, const char* payload, size_t length);
+
+/**
+ * Accoda i pezzi successivi della classifica in corso di invio ad un client
+ * @param state ServerState* struttura del server
+ * @param client_socket socket del client
+ * @return true se non si sono verificati errori, false altrimenti
+ * @note Si accoda al più un pezzo di SCOREBOARD_CHUNK_SIZE byte per volta, e solo
+ * quando l'uscita del client è quasi vuota: la memoria usata per ogni richiesta
+ * non dipende dal numero di giocatori. Va chiamata ogni volta che l'uscita si svuota
+ */
+bool pump_client_stream(ServerState* state, int client_socket);
+
+/**
+ * Invia le risposte accodate durante l'iterazione a tutti i client interessati
+ * @param state ServerState* struttura del server
+ * @note Tutti i messaggi accodati per un client partono con una sola send;
+ * i client per cui l'invio fallisce vengono disconnessi
+ */
+void flush_dirty_clients(ServerState* state);
+
+/**
+ * Invia quanto possibile del buffer in uscita di un client senza bloccare
+ * @param state ServerState* struttura del server
+ * @param client_socket socket del client
+ * @return true se non si sono verificati errori, false altrimenti
+ * @note Se il socket è pieno il client viene monitorato per EPOLLOUT e la sua
+ * lettura viene sospesa finché il buffer non si svuota
+ */
+bool flush_client_output(ServerState* state, int client_socket);
+
+/**
+ * Gestisce un socket client tornato scrivibile
+ * @param state ServerState* struttura del server
+ * @param client_socket socket del client
+ */
+void handle_client_writable(ServerState* state, int client_socket);
+
+/**
+ * Accoda header e payload di un messaggio sulla connessione io_uring di un client
+ * @param state ServerState* struttura del server
+ * @param client_socket socket del client
+ * @param header byte dell'header già codificato
+ * @param header_size numero di byte di header
+ * @param payload byte del payload, NULL se nessuno
+ * @param length numero di byte di payload
+ * @return numero di byte accodati, ERR_SEND in caso di errore
+ */
+ssize_t queue_uring_output(ServerState* state, int client_socket, const char* header,
+                           size_t header_size, const char* payload, size_t length);
+
 /**
  * Invia un messaggio a tutti i client connessi
  * @param state ServerState* struttura del server
@@ -114,50 +476,57 @@ void broadcast_message(ServerState* state, Message* msg);
  * Non essendoci una password di autenticazione, chiunque può riconnettersi con lo stesso nickname.
  * @param state ServerState* struttura del server
  * @param client_socket socket del client
- * @note Rimuove il client dai descrittori attivi
+ * @note Rimuove il client dal ciclo di eventi
  */
 void handle_disconnect(ServerState* state, int client_socket);
 
 /**
- * Gestisce la chiusura del server
- * @note Invia un messaggio di disconnessione a tutti i client
+ * Gestisce la chiusura di un worker del server
+ * @param state ServerState* worker in chiusura
+ * @note Invia un messaggio di disconnessione a tutti i client del worker.
+ * Con io_uring attende le send per al più SHUTDOWN_DRAIN_MS
  */
-void handle_shutdown();
+void handle_shutdown(ServerState* state);
+
+/**
+ * Corpo di un thread worker
+ * @param arg ServerState* del worker
+ * @return NULL
+ * @note Esegue il ciclo di eventi del motore scelto finché il thread principale non
+ * scrive sul wakeup_fd del worker
+ */
+void* run_worker(void* arg);
 
 /**
  * Mostra lo stato del server
  * @param state ServerState* struttura del server
+ * @note Viene chiamata all'avvio e alla ricezione di SIGUSR1
  */
 void display_server_status(ServerState* state);
 
 /**
  * Invia un prompt per il nickname al client
+ * @param state ServerState* struttura del server
  * @param client_socket socket del client
  */
-void send_nickname_prompt(int client_socket);
+void send_nickname_prompt(ServerState* state, int client_socket);
 
 /**
  * Invia il messaggio con i quiz disponibili al client
- * con il nickname specificato
+ * per il giocatore con cui ha effettuato il login
+ * @param state ServerState* struttura del server
  * @param client_socket socket del client
- * @param nickname nickname del client
  */
-void send_quiz_available_message(int client_socket, const char* nickname);
+void send_quiz_available_message(ServerState* state, int client_socket);
 
 /**
  * Invia una domanda ad un client
+ * @param state ServerState* struttura del server
  * @param client_socket socket del client
  * @param quiz Quiz* quiz corrente
  * @param question_num numero della domanda
  */
-void send_question_to_client(int client_socket, Quiz* quiz, int question_num);
-
-/**
- * Formatta i punteggi di tutti i giocatori in una stringa
- * @param state struttura ServerState contenente l'array dei giocatori
- * @return stringa formattata contenente tutti i punteggi
- */
-char* format_scores(ServerState* state);
+void send_question_to_client(ServerState* state, int client_socket, Quiz* quiz, int question_num);
 
 /**
  * @brief Gestisce l'aggiunta di un nuovo giocatore al server
@@ -168,6 +537,7 @@ char* format_scores(ServerState* state);
  * 
  * @return true se il giocatore è stato aggiunto con successo, false se non è stato
  * possibile aggiungere il giocatore
+ * @note Deve essere chiamata con il lock dei giocatori acquisito in scrittura
  */
 bool handle_new_player(ServerState* state, int client_socket, const char* nickname);
 
@@ -186,7 +556,8 @@ bool handle_new_player(ServerState* state, int client_socket, const char* nickna
  *         false se il giocatore è già connesso o ha completato tutti i quiz
  *
  * @note La funzione invia messaggi appropriati al client per informarlo dello stato
- *       della connessione e dei quiz disponibili
+ *       della connessione
+ * @note Deve essere chiamata con il lock dei giocatori acquisito in scrittura
  */
 bool handle_existing_player(ServerState* state, int client_socket, Player* player, const char* nickname);
 
@@ -296,4 +667,16 @@ void handle_answer(ServerState* state, int client_socket, Message* msg);
  */
 bool load_quiz_files();
 
+/**
+ * Libera i quiz caricati da load_quiz_files()
+ */
+void free_quiz_files();
+
+/**
+ * Codifica i messaggi di stato in frame pronti per entrambe le versioni del protocollo
+ * @note Va chiamata una volta prima di avviare i worker: da quel momento i frame
+ * vengono solo letti e sono condivisi da tutti i thread
+ */
+void build_status_frames();
+
 #endif
\ No newline at end of file
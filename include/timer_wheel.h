@@ -0,0 +1,117 @@
+// Timer wheel gerarchico usato dal server per le scadenze delle connessioni
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Bit di indice per livello: ogni livello ha 64 slot
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+// Numero di livelli: con tick da 100 ms coprono circa 7 ore
+#define TIMER_WHEEL_LEVELS 3
+
+/**
+ * Timer registrabile nella wheel
+ * @param prev Timer precedente nello slot
+ * @param next Timer successivo nello slot (NULL se il timer non è attivo)
+ * @param expires Tick di scadenza
+ * @param owner Identificativo del proprietario, restituito alla scadenza
+ * @note Il timer è di proprietà del chiamante: la wheel non lo alloca né lo libera
+ */
+typedef struct Timer {
+    struct Timer* prev;
+    struct Timer* next;
+    uint64_t expires;
+    uint64_t owner;
+} Timer;
+
+/**
+ * Timer wheel gerarchico
+ * @param slots Liste circolari di timer, con sentinella, per ogni livello e slot
+ * @param current Ultimo tick elaborato
+ * @param tick_ms Durata di un tick in millisecondi
+ * @param count Numero di timer attivi
+ * @note Inserimento, rimozione e scadenza costano O(1); i timer lontani
+ * stanno nei livelli alti e scendono di livello solo quando si avvicinano
+ */
+typedef struct {
+    Timer slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint64_t current;
+    uint64_t tick_ms;
+    int count;
+} TimerWheel;
+
+/**
+ * Funzione chiamata alla scadenza di un timer
+ * @param timer timer scaduto, già rimosso dalla wheel
+ * @param ctx contesto passato a timer_wheel_advance()
+ * @note Può riprogrammare o annullare qualsiasi timer, compreso quello scaduto
+ */
+typedef void (*TimerCallback)(Timer* timer, void* ctx);
+
+/**
+ * Restituisce il tempo monotono corrente
+ * @return millisecondi da un istante di riferimento arbitrario
+ */
+uint64_t timer_now_ms();
+
+/**
+ * Crea una timer wheel vuota
+ * @param tick_ms durata di un tick in millisecondi
+ * @param now_ms tempo corrente (da timer_now_ms())
+ * @return TimerWheel* inizializzata o NULL in caso di errore
+ */
+TimerWheel* create_timer_wheel(uint64_t tick_ms, uint64_t now_ms);
+
+/**
+ * Libera la timer wheel
+ * @param wheel TimerWheel* da liberare
+ * @note I timer ancora registrati non vengono liberati
+ */
+void free_timer_wheel(TimerWheel* wheel);
+
+/**
+ * Programma (o riprogramma) un timer
+ * @param wheel TimerWheel* di destinazione
+ * @param timer timer da programmare, eventualmente già attivo
+ * @param expires_ms istante di scadenza in millisecondi
+ * @note Le scadenze oltre la portata della wheel vengono anticipate al
+ * massimo rappresentabile: il proprietario può riprogrammare alla scadenza
+ */
+void timer_wheel_schedule(TimerWheel* wheel, Timer* timer, uint64_t expires_ms);
+
+/**
+ * Annulla un timer
+ * @param wheel TimerWheel* in cui è registrato il timer
+ * @param timer timer da annullare, anche se non attivo
+ */
+void timer_wheel_cancel(TimerWheel* wheel, Timer* timer);
+
+/**
+ * Indica se un timer è attivo
+ * @param timer timer da controllare
+ * @return true se il timer è registrato in una wheel
+ */
+bool timer_is_active(const Timer* timer);
+
+/**
+ * Calcola quanto attendere prima della prossima scadenza
+ * @param wheel TimerWheel* da interrogare
+ * @param now_ms tempo corrente
+ * @return millisecondi da attendere, -1 se non ci sono timer attivi
+ * @note Il valore è adatto come timeout di epoll_wait: senza timer il
+ * ciclo di eventi non si risveglia mai per la wheel
+ */
+int timer_wheel_timeout(TimerWheel* wheel, uint64_t now_ms);
+
+/**
+ * Fa avanzare la wheel fino al tempo corrente chiamando callback per ogni timer scaduto
+ * @param wheel TimerWheel* da far avanzare
+ * @param now_ms tempo corrente
+ * @param callback funzione chiamata per ogni timer scaduto
+ * @param ctx contesto passato a callback
+ */
+void timer_wheel_advance(TimerWheel* wheel, uint64_t now_ms, TimerCallback callback, void* ctx);
+
+#endif
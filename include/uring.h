@@ -0,0 +1,143 @@
+// Interfaccia minimale verso io_uring, usata dal motore di I/O opzionale del server
+#ifndef URING_H
+#define URING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+// Identificativo del gruppo di buffer forniti usato dalle recv
+#define URING_BUFFER_GROUP 0
+
+/**
+ * Istanza io_uring con il relativo anello di buffer forniti al kernel
+ * @param ring_fd File descriptor restituito da io_uring_setup
+ * @param sq_head Testa della submission queue (aggiornata dal kernel)
+ * @param sq_tail Coda della submission queue (aggiornata da noi)
+ * @param sq_mask Maschera degli indici della submission queue
+ * @param sq_entries Numero di slot della submission queue
+ * @param sq_array Array di indirezione degli SQE
+ * @param sqes SQE condivisi con il kernel
+ * @param sq_local_tail SQE preparati ma non ancora pubblicati al kernel
+ * @param cq_head Testa della completion queue (aggiornata da noi)
+ * @param cq_tail Coda della completion queue (aggiornata dal kernel)
+ * @param cq_mask Maschera degli indici della completion queue
+ * @param cqes CQE condivisi con il kernel
+ * @param sq_ring Mappatura dell'anello di submission (e completion con SINGLE_MMAP)
+ * @param sq_ring_size Dimensione della mappatura sq_ring
+ * @param cq_ring Mappatura dell'anello di completion
+ * @param cq_ring_size Dimensione della mappatura cq_ring
+ * @param sqes_size Dimensione della mappatura degli SQE
+ * @param buf_ring Anello dei buffer forniti al kernel per le recv
+ * @param buf_ring_size Dimensione della mappatura buf_ring
+ * @param buf_base Memoria dei buffer forniti
+ * @param buf_count Numero di buffer forniti (potenza di 2)
+ * @param buf_size Dimensione di ciascun buffer fornito
+ * @param buf_tail Coda locale dell'anello dei buffer
+ */
+typedef struct {
+    int ring_fd;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    unsigned sq_local_tail;
+
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+
+    struct io_uring_buf_ring* buf_ring;
+    size_t buf_ring_size;
+    char* buf_base;
+    unsigned buf_count;
+    unsigned buf_size;
+    unsigned short buf_tail;
+} IoUring;
+
+/**
+ * Crea un'istanza io_uring e registra il gruppo di buffer forniti
+ * @param entries numero di slot della submission queue
+ * @param buf_count numero di buffer per le recv (potenza di 2)
+ * @param buf_size dimensione di ciascun buffer
+ * @return IoUring* inizializzata o NULL se io_uring non è disponibile
+ */
+IoUring* create_uring(unsigned entries, unsigned buf_count, unsigned buf_size);
+
+/**
+ * Libera l'istanza io_uring e i buffer associati
+ * @param ring IoUring* da liberare
+ */
+void free_uring(IoUring* ring);
+
+/**
+ * Restituisce un SQE libero già azzerato
+ * @param ring IoUring* istanza
+ * @return SQE da preparare o NULL se la submission queue è piena
+ * @note In caso di coda piena è sufficiente chiamare uring_submit() e riprovare
+ */
+struct io_uring_sqe* uring_get_sqe(IoUring* ring);
+
+/**
+ * Prepara un SQE con i campi comuni a tutte le operazioni
+ * @param sqe SQE ottenuto da uring_get_sqe()
+ * @param opcode operazione (IORING_OP_*)
+ * @param fd descrittore su cui operare
+ * @param addr indirizzo del buffer (o NULL)
+ * @param len lunghezza del buffer
+ * @param user_data valore restituito nel CQE corrispondente
+ */
+void uring_prep(struct io_uring_sqe* sqe, int opcode, int fd,
+                const void* addr, unsigned len, uint64_t user_data);
+
+/**
+ * Pubblica al kernel gli SQE preparati e attende dei completamenti
+ * @param ring IoUring* istanza
+ * @param wait_nr numero minimo di completamenti da attendere (0 per non attendere)
+ * @param timeout_ms tempo massimo di attesa in millisecondi (-1 per attesa infinita)
+ * @return numero di SQE consumati dal kernel, -1 in caso di errore
+ * @note Un'interruzione da segnale (EINTR) e lo scadere del timeout vengono
+ * riportati come 0: i CQE vanno comunque controllati con uring_peek_cqe()
+ */
+int uring_submit(IoUring* ring, unsigned wait_nr, int timeout_ms);
+
+/**
+ * Restituisce il primo CQE disponibile senza bloccare
+ * @param ring IoUring* istanza
+ * @return CQE o NULL se la completion queue è vuota
+ */
+struct io_uring_cqe* uring_peek_cqe(IoUring* ring);
+
+/**
+ * Segnala al kernel che il CQE restituito da uring_peek_cqe() è stato consumato
+ * @param ring IoUring* istanza
+ */
+void uring_cqe_seen(IoUring* ring);
+
+/**
+ * Restituisce il buffer fornito indicato da un CQE di recv
+ * @param ring IoUring* istanza
+ * @param bid identificativo del buffer (cqe->flags >> IORING_CQE_BUFFER_SHIFT)
+ * @return puntatore ai dati del buffer
+ */
+char* uring_buffer(IoUring* ring, unsigned short bid);
+
+/**
+ * Restituisce al kernel un buffer fornito dopo averne consumato i dati
+ * @param ring IoUring* istanza
+ * @param bid identificativo del buffer
+ */
+void uring_recycle_buffer(IoUring* ring, unsigned short bid);
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * buffer.c
+ * Implementazione del buffer di byte dinamico per 'Trivia Quiz Multiplayer'
+ *
+ * Il server riceve dai socket flussi di byte che non coincidono necessariamente
+ * con i messaggi del protocollo: un messaggio può arrivare spezzato in più
+ * letture oppure più messaggi possono arrivare insieme. Questo buffer accumula
+ * i byte ricevuti finché non contengono messaggi completi.
+ */
+
+#include "include/buffer.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool reserve_buffer(ByteBuffer* buffer, size_t extra) {
+    if (buffer->length + extra <= buffer->capacity) return true;
+
+    size_t new_capacity = buffer->capacity > 0 ? buffer->capacity : 256;
+    while (new_capacity < buffer->length + extra) {
+        new_capacity *= 2; // Raddoppia la capacità
+    }
+
+    char* new_data = realloc(buffer->data, new_capacity);
+    if (!new_data) return false;
+
+    buffer->data = new_data;
+    buffer->capacity = new_capacity;
+    return true;
+}
+
+bool append_to_buffer(ByteBuffer* buffer, const void* data, size_t length) {
+    if (!reserve_buffer(buffer, length)) return false;
+
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return true;
+}
+
+bool append_format(ByteBuffer* buffer, const char* format, ...) {
+    size_t available = buffer->capacity - buffer->length;
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(available > 0 ? buffer->data + buffer->length : NULL,
+                            available, format, args);
+    va_end(args);
+    if (written < 0) return false;
+
+    // Spazio insufficiente: si allarga il buffer e si formatta di nuovo
+    if ((size_t)written >= available) {
+        if (!reserve_buffer(buffer, (size_t)written + 1)) return false;
+        va_start(args, format);
+        vsnprintf(buffer->data + buffer->length, (size_t)written + 1, format, args);
+        va_end(args);
+    }
+
+    buffer->length += written;
+    return true;
+}
+
+void clear_buffer(ByteBuffer* buffer) {
+    buffer->length = 0;
+}
+
+void consume_buffer(ByteBuffer* buffer, size_t length) {
+    if (length >= buffer->length) {
+        buffer->length = 0;
+        return;
+    }
+
+    // Sposta in testa i byte non ancora consumati
+    memmove(buffer->data, buffer->data + length, buffer->length - length);
+    buffer->length -= length;
+}
+
+void release_buffer(ByteBuffer* buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
@@ -27,6 +27,18 @@ ClientState* init_client() {
     state->nickname[0] = '\0';
     state->current_quiz = 0;
     state->current_question = 0;
+    state->protocol_version = PROTOCOL_VERSION_LEGACY;
+    state->pipeline = false;
+    state->pending_scores = 0;
+    state->next_buffer = NULL;
+    state->scores = NULL;
+    state->score_count = 0;
+    state->score_capacity = 0;
+    state->score_index = NULL;
+    state->score_index_capacity = 0;
+    state->score_version = 0;
+    memset(state->score_first, -1, sizeof(state->score_first));
+    memset(state->score_last, -1, sizeof(state->score_last));
     
     return state;
 }
@@ -36,6 +48,9 @@ void cleanup_client(ClientState* state) {
         if (state->socket != -1) {
             close(state->socket);
         }
+        free(state->next_buffer);
+        free(state->scores);
+        free(state->score_index);
         free(state);
     }
 }
@@ -50,10 +65,472 @@ bool connect_to_server(ClientState* state, int port) {
     }
     
     state->socket = sock;
+    // La versione viene negoziata ad ogni connessione con MSG_LOGIN
+    state->protocol_version = PROTOCOL_VERSION_LEGACY;
+    state->pending_scores = 0;
+    // La classifica conservata appartiene alla connessione precedente
+    state->score_count = 0;
+    free(state->score_index);
+    state->score_index = NULL;
+    state->score_index_capacity = 0;
+    state->score_version = 0;
+    memset(state->score_first, -1, sizeof(state->score_first));
+    memset(state->score_last, -1, sizeof(state->score_last));
     DEBUG_PRINT("Connesso con socket %d\n", state->socket);
     return true;
 }
 
+/* Funzioni di comunicazione con il server */
+
+ssize_t send_to_server(ClientState* state, Message* msg) {
+    return send_message(state->socket, msg, state->protocol_version);
+}
+
+/**
+ * Aggiunge una voce in coda alla lista del suo punteggio in un quiz
+ * @param state struttura ClientState
+ * @param index posizione della voce in scores, con il punteggio già impostato
+ * @param quiz quiz della lista (0 Sport, 1 Geografia)
+ */
+static void link_score_entry(ClientState* state, int index, int quiz) {
+    ScoreEntry* entry = &state->scores[index];
+    uint32_t score = entry->scores[quiz];
+    entry->prev[quiz] = state->score_last[quiz][score];
+    entry->next[quiz] = -1;
+    if (entry->prev[quiz] >= 0) {
+        state->scores[entry->prev[quiz]].next[quiz] = index;
+    } else {
+        state->score_first[quiz][score] = index;
+    }
+    state->score_last[quiz][score] = index;
+}
+
+/**
+ * Stacca una voce dalla lista del suo punteggio in un quiz
+ * @param state struttura ClientState
+ * @param index posizione della voce in scores
+ * @param quiz quiz della lista (0 Sport, 1 Geografia)
+ */
+static void unlink_score_entry(ClientState* state, int index, int quiz) {
+    ScoreEntry* entry = &state->scores[index];
+    uint32_t score = entry->scores[quiz];
+    if (entry->prev[quiz] >= 0) {
+        state->scores[entry->prev[quiz]].next[quiz] = entry->next[quiz];
+    } else {
+        state->score_first[quiz][score] = entry->next[quiz];
+    }
+    if (entry->next[quiz] >= 0) {
+        state->scores[entry->next[quiz]].prev[quiz] = entry->prev[quiz];
+    } else {
+        state->score_last[quiz][score] = entry->prev[quiz];
+    }
+}
+
+/**
+ * Restituisce la voce di score_index che contiene un nickname
+ * @param state struttura ClientState con score_index allocata
+ * @param nickname caratteri del nickname
+ * @param length numero di caratteri
+ * @param hash hash del nickname
+ * @return voce del nickname, o la prima voce vuota incontrata se non c'è
+ */
+static int find_score_slot(const ClientState* state, const char* nickname, size_t length, uint32_t hash) {
+    int mask = state->score_index_capacity - 1;
+    int slot = hash & mask;
+    while (state->score_index[slot] >= 0) {
+        const ScoreEntry* entry = &state->scores[state->score_index[slot]];
+        if (entry->hash == hash && strncmp(entry->nickname, nickname, length) == 0 &&
+            entry->nickname[length] == '\0') {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Ricostruisce score_index con un nuovo numero di voci
+ * @param state struttura ClientState
+ * @param capacity nuovo numero di voci, potenza di 2 maggiore di score_count
+ * @return true se la tabella è stata ricostruita, false se l'allocazione fallisce
+ */
+static bool rebuild_score_index(ClientState* state, int capacity) {
+    int* index = malloc(sizeof(int) * capacity);
+    if (!index) return false;
+    memset(index, -1, sizeof(int) * capacity);
+
+    for (int i = 0; i < state->score_count; i++) {
+        int slot = state->scores[i].hash & (capacity - 1);
+        while (index[slot] >= 0) slot = (slot + 1) & (capacity - 1);
+        index[slot] = i;
+    }
+
+    free(state->score_index);
+    state->score_index = index;
+    state->score_index_capacity = capacity;
+    return true;
+}
+
+/**
+ * Aggiorna la classifica conservata con un payload v2
+ * @param state struttura ClientState
+ * @param reader cursore posizionato sulla classifica
+ * @return true se la classifica è valida, false altrimenti
+ * @note Una classifica completa sostituisce quella conservata, altrimenti
+ * le voci ricevute aggiornano o si aggiungono a quelle esistenti. Le voci
+ * esistenti si trovano con score_index e un punteggio cambiato sposta la voce
+ * in coda alla lista del nuovo punteggio, quindi il costo è lineare nelle voci ricevute
+ */
+static bool apply_scores(ClientState* state, PayloadReader* reader) {
+    uint32_t version = read_varint(reader);
+    uint8_t kind = read_u8(reader);
+    uint32_t count = read_varint(reader);
+    // Ogni voce occupa più di un byte: un numero maggiore del payload non è valido
+    if (reader->error || count > reader->length) return false;
+
+    if (kind & SCOREBOARD_FULL) {
+        state->score_count = 0;
+        if (state->score_index) {
+            memset(state->score_index, -1, sizeof(int) * state->score_index_capacity);
+        }
+        memset(state->score_first, -1, sizeof(state->score_first));
+        memset(state->score_last, -1, sizeof(state->score_last));
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        size_t length;
+        const char* nickname = read_string(reader, &length);
+        uint32_t sport = read_varint(reader);
+        uint32_t geography = read_varint(reader);
+        uint8_t flags = read_u8(reader);
+        if (reader->error || length >= MAX_NICK_LENGTH ||
+            sport >= SCORE_BUCKETS || geography >= SCORE_BUCKETS) {
+            // Classifica parziale: alla prossima richiesta serve quella completa
+            state->score_version = 0;
+            return false;
+        }
+
+        // La tabella resta piena al più per metà, così le sequenze di scansione sono brevi
+        if ((state->score_count + 1) * 2 > state->score_index_capacity &&
+            !rebuild_score_index(state, state->score_index_capacity > 0 ?
+                                        state->score_index_capacity * 2 : 32)) {
+            state->score_version = 0;
+            return false;
+        }
+
+        uint32_t hash = hash_nickname(nickname, length);
+        int slot = find_score_slot(state, nickname, length, hash);
+        int index = state->score_index[slot];
+        if (index < 0) {
+            if (state->score_count == state->score_capacity) {
+                int new_capacity = state->score_capacity > 0 ? state->score_capacity * 2 : 16;
+                ScoreEntry* new_scores = realloc(state->scores, sizeof(ScoreEntry) * new_capacity);
+                if (!new_scores) {
+                    state->score_version = 0;
+                    return false;
+                }
+                state->scores = new_scores;
+                state->score_capacity = new_capacity;
+            }
+            index = state->score_count++;
+            state->score_index[slot] = index;
+            ScoreEntry* entry = &state->scores[index];
+            memcpy(entry->nickname, nickname, length);
+            entry->nickname[length] = '\0';
+            entry->hash = hash;
+            entry->scores[0] = sport;
+            entry->scores[1] = geography;
+            link_score_entry(state, index, 0);
+            link_score_entry(state, index, 1);
+        }
+
+        // Un punteggio cambiato porta la voce in fondo ai nuovi pari merito
+        const uint32_t updated[2] = {sport, geography};
+        for (int quiz = 0; quiz < 2; quiz++) {
+            if (state->scores[index].scores[quiz] != updated[quiz]) {
+                unlink_score_entry(state, index, quiz);
+                state->scores[index].scores[quiz] = updated[quiz];
+                link_score_entry(state, index, quiz);
+            }
+        }
+        state->scores[index].flags = flags;
+    }
+
+    state->score_version = version;
+    return true;
+}
+
+/**
+ * Compone il testo della classifica conservata
+ * @param state struttura ClientState
+ * @param out ByteBuffer* in cui aggiungere il testo
+ * @return true se il testo è stato composto, false altrimenti
+ * @note Il testo è lo stesso prodotto dal server per i client v1
+ */
+static bool render_scores(ClientState* state, ByteBuffer* out) {
+    int count = state->score_count;
+    const ScoreEntry* entries = state->scores;
+
+    bool ok = append_format(out, "\nPartecipanti (%d):\n", count);
+    if (count == 0) ok = ok && append_format(out, "Nessun giocatore presente\n");
+    for (int i = 0; i < count; i++) {
+        ok = ok && append_format(out, "- %s\n", entries[i].nickname);
+    }
+
+    const char* quiz_names[2] = {"Sport", "Geografia"};
+    // Le liste per punteggio, dal più alto, danno già l'ordine della classifica
+    for (int quiz = 0; quiz < 2; quiz++) {
+        ok = ok && append_format(out, "\nPunteggio %s:\n", quiz_names[quiz]);
+        if (count == 0) ok = ok && append_format(out, "Nessun giocatore ha ancora partecipato\n");
+        for (int score = SCORE_BUCKETS - 1; score >= 0; score--) {
+            for (int i = state->score_first[quiz][score]; i >= 0; i = entries[i].next[quiz]) {
+                ok = ok && append_format(out, "- %s: %u\n", entries[i].nickname, entries[i].scores[quiz]);
+            }
+        }
+    }
+
+    const uint8_t completed_flags[2] = {SCORE_FLAG_COMPLETED_SPORT, SCORE_FLAG_COMPLETED_GEOGRAPHY};
+    for (int quiz = 0; quiz < 2; quiz++) {
+        ok = ok && append_format(out, "\nQuiz %s completato da:\n", quiz_names[quiz]);
+        bool has_completed = false;
+        for (int i = 0; i < count; i++) {
+            if (entries[i].flags & completed_flags[quiz]) {
+                ok = ok && append_format(out, "- %s\n", entries[i].nickname);
+                has_completed = true;
+            }
+        }
+        if (!has_completed) ok = ok && append_format(out, "Nessun giocatore ha completato questo quiz\n");
+    }
+
+    return ok;
+}
+
+/**
+ * Compone il testo di una pagina della classifica di un quiz
+ * @param reader cursore posizionato sulla pagina
+ * @param out ByteBuffer* in cui aggiungere il testo
+ * @return true se la pagina è valida, false altrimenti
+ */
+static bool render_score_page(PayloadReader* reader, ByteBuffer* out) {
+    uint8_t quiz = read_u8(reader);
+    uint8_t flags = read_u8(reader);
+    uint32_t total = read_varint(reader);
+    uint32_t offset = read_varint(reader);
+    uint32_t count = read_varint(reader);
+    if (reader->error || count > SCORE_PAGE_MAX_ENTRIES) return false;
+
+    bool ok = append_format(out, "\nClassifica %s (%u giocatori):\n",
+                            quiz == 1 ? "Sport" : "Geografia", total);
+    if (count == 0) ok = ok && append_format(out, "Nessun giocatore in questa pagina\n");
+
+    for (uint32_t i = 0; i < count; i++) {
+        size_t length;
+        const char* nickname = read_string(reader, &length);
+        uint32_t score = read_varint(reader);
+        if (reader->error) return false;
+        ok = ok && append_format(out, "%u. %.*s: %u\n", offset + i + 1, (int)length, nickname, score);
+    }
+
+    if (flags & SCORE_QUERY_MY_RANK) {
+        uint32_t rank = read_varint(reader);
+        uint32_t score = read_varint(reader);
+        if (reader->error) return false;
+        if (rank > 0) {
+            ok = ok && append_format(out, "La tua posizione: %u (punteggio %u)\n", rank, score);
+        } else {
+            ok = ok && append_format(out, "Non sei ancora in classifica\n");
+        }
+    }
+    return ok;
+}
+
+/**
+ * Compone il testo delle voci vicine al giocatore in MSG_RANK
+ * @param reader cursore posizionato sul numero di voci
+ * @param out ByteBuffer* in cui aggiungere il testo
+ * @return true se le voci sono valide, false altrimenti
+ */
+static bool render_rank_entries(PayloadReader* reader, ByteBuffer* out) {
+    uint32_t count = read_varint(reader);
+    if (reader->error || count > RANK_NEIGHBOURS) return false;
+
+    bool ok = true;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t rank = read_varint(reader);
+        size_t length;
+        const char* nickname = read_string(reader, &length);
+        uint32_t score = read_varint(reader);
+        if (reader->error) return false;
+        ok = ok && append_format(out, "%u. %.*s: %u\n", rank, (int)length, nickname, score);
+    }
+    return ok;
+}
+
+/**
+ * Compone il testo della posizione del giocatore in un quiz
+ * @param state struttura ClientState
+ * @param reader cursore posizionato sulla risposta
+ * @param out ByteBuffer* in cui aggiungere il testo
+ * @return true se la risposta è valida, false altrimenti
+ */
+static bool render_rank(ClientState* state, PayloadReader* reader, ByteBuffer* out) {
+    uint8_t quiz = read_u8(reader);
+    uint32_t total = read_varint(reader);
+    uint32_t rank = read_varint(reader);
+    uint32_t score = read_varint(reader);
+    if (reader->error) return false;
+
+    bool ok = append_format(out, "\nPosizione %s (%u giocatori):\n",
+                            quiz == 1 ? "Sport" : "Geografia", total);
+    if (rank == 0) {
+        return ok && append_format(out, "Non sei ancora in classifica\n");
+    }
+
+    return ok && render_rank_entries(reader, out) &&
+           append_format(out, "%u. %s: %u  <-- tu\n", rank, state->nickname, score) &&
+           render_rank_entries(reader, out);
+}
+
+/**
+ * Compone il testo da mostrare per un payload v2
+ * @param state struttura ClientState
+ * @param msg messaggio ricevuto
+ * @param out ByteBuffer* in cui aggiungere il testo
+ * @return true se il payload è valido, false altrimenti
+ */
+static bool render_payload(ClientState* state, const Message* msg, ByteBuffer* out) {
+    PayloadReader reader;
+    init_payload_reader(&reader, msg->payload, msg->length);
+
+    switch (msg->type) {
+        case MSG_NICKNAME_PROMPT:
+            return append_format(out, "%s", status_text(STATUS_NICKNAME_PROMPT));
+
+        case MSG_LOGIN_SUCCESS:
+        case MSG_LOGIN_ERROR:
+        case MSG_ANSWER_RESULT:
+        case MSG_QUIZ_COMPLETED:
+        case MSG_ERROR:
+            {
+                uint8_t code = read_u8(&reader);
+                return !reader.error && append_format(out, "%s", status_text(code));
+            }
+
+        case MSG_QUIZ_AVAILABLE:
+            {
+                uint8_t available = read_u8(&reader);
+                if (reader.error) return false;
+
+                bool ok = true;
+                if (reader.offset < reader.length) {
+                    ok = append_format(out, "%s", status_text(read_u8(&reader)));
+                }
+                if (!available) {
+                    return ok && append_format(out, "Non ci sono più quiz disponibili.\n"
+                                                  "Hai completato tutti i quiz!\n");
+                }
+                ok = ok && append_format(out, "Quiz disponibili\n"
+                                            "++++++++++++++++++++++++++++++\n");
+                if (available & QUIZ_MASK_SPORT) ok = ok && append_format(out, "1 - Sport\n");
+                if (available & QUIZ_MASK_GEOGRAPHY) ok = ok && append_format(out, "2 - Geografia\n");
+                return ok && append_format(out, "++++++++++++++++++++++++++++++\n");
+            }
+
+        case MSG_QUESTION:
+            {
+                read_u8(&reader);  // Quiz della domanda, già noto al client
+                uint8_t number = read_u8(&reader);
+                size_t topic_length, question_length;
+                const char* topic = read_string(&reader, &topic_length);
+                const char* question = read_string(&reader, &question_length);
+                return !reader.error &&
+                       append_format(out, "\nQuiz %.*s (domanda %d)\n"
+                                        "++++++++++++++++++++++++++++++++++++\n"
+                                        "Domanda: %.*s",
+                                   (int)topic_length, topic, number,
+                                   (int)question_length, question);
+            }
+
+        case MSG_SCORE:
+            return apply_scores(state, &reader) && render_scores(state, out);
+
+        case MSG_SCORE_PAGE:
+            return render_score_page(&reader, out);
+
+        case MSG_RANK:
+            return render_rank(state, &reader, out);
+
+        case MSG_TRIVIA_COMPLETED:
+            return apply_scores(state, &reader) &&
+                   append_format(out, "%s\n\n", status_text(STATUS_TRIVIA_COMPLETED)) &&
+                   render_scores(state, out);
+
+        default:
+            // Gli altri messaggi (es. MSG_DISCONNECT) hanno un payload testuale
+            return msg->length == 0 || append_to_buffer(out, msg->payload, msg->length);
+    }
+}
+
+ssize_t receive_server_message(ClientState* state, Message* msg) {
+    while (true) {
+        ssize_t received;
+        char* received_payload;
+
+        if (state->next_buffer) {
+            // Messaggio successivo arrivato insieme all'esito della risposta
+            *msg = state->next_message;
+            received = msg->length;
+            received_payload = state->next_buffer;
+            state->next_buffer = NULL;
+        } else {
+            received = receive_message(state->socket, msg, state->protocol_version);
+            if (received < 0) return received;
+            received_payload = msg->payload;
+
+            // Il server conferma la versione: i messaggi successivi usano il nuovo framing
+            if (msg->type == MSG_VERSION) {
+                if (msg->length >= 1 && (uint8_t)msg->payload[0] >= PROTOCOL_VERSION) {
+                    state->protocol_version = PROTOCOL_VERSION;
+                }
+                free(msg->payload);
+                continue;
+            }
+
+            if (state->protocol_version < PROTOCOL_VERSION) return received;
+
+            // [esito][tipo][payload]: si restituisce l'esito e si conserva il
+            // resto, il cui payload resta nel buffer ricevuto
+            if (msg->type == MSG_ANSWER_NEXT) {
+                if (msg->length < 2) {
+                    free(msg->payload);
+                    return ERR_RECV;
+                }
+                state->next_message.type = (uint8_t)msg->payload[1];
+                state->next_message.length = msg->length - 2;
+                state->next_message.payload = msg->payload + 2;
+                state->next_buffer = msg->payload;
+                received_payload = NULL;
+
+                msg->type = MSG_ANSWER_RESULT;
+                msg->length = 1;
+            }
+        }
+
+        // Il testo sostituisce il payload strutturato ed è terminato da '\0' come in v1
+        ByteBuffer text;
+        memset(&text, 0, sizeof(text));
+        bool rendered = render_payload(state, msg, &text) && append_to_buffer(&text, "", 1);
+        free(received_payload);
+        if (!rendered) {
+            release_buffer(&text);
+            return ERR_RECV;
+        }
+        msg->payload = text.data;
+        msg->length = text.length - 1;
+        return received;
+    }
+}
+
 /* Funzioni di gestione della UI */
 
 void print_banner() {
@@ -149,12 +626,14 @@ static bool is_valid_nickname(const char* nickname) {
  * @return true se l'invio è avvenuto con successo, false altrimenti
  */
 static bool send_initial_login_request(ClientState* state) {
+    // Il payload è la versione più alta supportata: un server v1 lo ignora
+    char version = PROTOCOL_VERSION;
     Message msg;
     msg.type = MSG_LOGIN;
-    msg.length = 0;
-    msg.payload = NULL;
+    msg.length = 1;
+    msg.payload = &version;
     
-    return send_message(state->socket, &msg) >= 0;
+    return send_to_server(state, &msg) >= 0;
 }
 
 /**
@@ -166,13 +645,14 @@ static bool send_initial_login_request(ClientState* state) {
  * @return true se la ricezione è avvenuta con successo, false altrimenti
  */
 static bool receive_show_server_prompt(ClientState* state, Message* msg) {
-    if (receive_message(state->socket, msg) < 0) {
+    if (receive_server_message(state, msg) < 0) {
         printf("Server disconnesso durante la scelta del nickname\n");
         return false;
     }
     
     // Display the prompt or error message
     printf("\n%s", msg->payload);
+    free(msg->payload);
     return true;
 }
 
@@ -216,7 +696,7 @@ static bool send_nickname_to_server(ClientState* state) {
         return false;
     strcpy(msg.payload, state->nickname);
 
-    bool success = send_message(state->socket, &msg) >= 0;
+    bool success = send_to_server(state, &msg) >= 0;
     free(msg.payload);
     return success;
 }
@@ -230,7 +710,7 @@ static bool send_nickname_to_server(ClientState* state) {
  * @return true se la risposta è stata gestita con successo, false altrimenti
  */
 static bool handle_server_nickname_response(ClientState* state, Message* msg, bool* nickname_accepted) {
-    if (receive_message(state->socket, msg) < 0) {
+    if (receive_server_message(state, msg) < 0) {
         return false;
     }
     
@@ -247,9 +727,11 @@ static bool handle_server_nickname_response(ClientState* state, Message* msg, bo
             
         default:
             printf("Messaggio inaspettato dal server\n");
+            free(msg->payload);
             return false;
     }
     
+    free(msg->payload);
     return true;
 }
 
@@ -264,7 +746,7 @@ static bool request_new_prompt(ClientState* state) {
     msg.type = MSG_LOGIN;
     msg.length = 0;
     
-    return send_message(state->socket, &msg) >= 0;
+    return send_to_server(state, &msg) >= 0;
 }
 
 bool validate_and_send_nickname(ClientState* state) {
@@ -325,6 +807,24 @@ bool print_answer_result(Message* msg) {
     }
 }
 
+/**
+ * Prepara una richiesta della classifica
+ * @param state struttura ClientState
+ * @param msg messaggio da preparare
+ * @param encoded buffer per il payload, grande almeno 5 byte
+ * @note In v2 il payload è la versione della classifica conservata, così il
+ * server invia solo le voci cambiate da allora; in v1 il payload è vuoto
+ */
+static void prepare_score_request(ClientState* state, Message* msg, char* encoded) {
+    msg->type = MSG_REQUEST_SCORE;
+    msg->length = 0;
+    msg->payload = NULL;
+    if (state->protocol_version >= PROTOCOL_VERSION) {
+        msg->length = encode_varint(state->score_version, encoded);
+        msg->payload = encoded;
+    }
+}
+
 bool submit_and_verify_answer(ClientState* state, const char* answer) {
     Message msg;
     msg.type = MSG_ANSWER;
@@ -332,14 +832,23 @@ bool submit_and_verify_answer(ClientState* state, const char* answer) {
     msg.payload = malloc(msg.length + 1);
     if (!msg.payload) return false;
     strcpy(msg.payload, answer);
-    
-    if (send_message(state->socket, &msg) < 0) {
+
+    // In pipeline la classifica viene richiesta insieme alla risposta:
+    // il server elabora entrambi i messaggi con una sola lettura
+    Message batch[2];
+    char encoded[5];
+    batch[0] = msg;
+    prepare_score_request(state, &batch[1], encoded);
+    int count = state->pipeline ? 2 : 1;
+
+    if (send_messages(state->socket, batch, count, state->protocol_version) < 0) {
         free(msg.payload);
         return false;
     }
     free(msg.payload);  // Free dopo l'invio
+    state->pending_scores += count - 1;
     
-    if (receive_message(state->socket, &msg) < 0) {
+    if (receive_server_message(state, &msg) < 0) {
         return false;
     }
     
@@ -350,14 +859,52 @@ bool submit_and_verify_answer(ClientState* state, const char* answer) {
 
 bool handle_special_commands(ClientState* state, const char* answer) {
     Message msg;
-    
-    if (strcmp(answer, "show score") == 0) {
+
+    // Una pagina della classifica del quiz in corso, con la propria posizione
+    bool show_top = strncmp(answer, "show top", 8) == 0 && (answer[8] == '\0' || answer[8] == ' ');
+    if (show_top && state->protocol_version >= PROTOCOL_VERSION) {
+        int page = atoi(answer + 8);
+        if (page < 1) page = 1;
+
+        ByteBuffer request;
+        memset(&request, 0, sizeof(request));
+        bool built = append_varint(&request, state->score_version) &&
+                     append_u8(&request, (uint8_t)state->current_quiz) &&
+                     append_varint(&request, (uint32_t)(page - 1) * SCORE_PAGE_SIZE) &&
+                     append_varint(&request, SCORE_PAGE_SIZE) &&
+                     append_u8(&request, SCORE_QUERY_MY_RANK);
+
         msg.type = MSG_REQUEST_SCORE;
-        msg.length = strlen(answer);
+        msg.length = request.length;
+        msg.payload = request.data;
+        bool success = built && send_to_server(state, &msg) >= 0;
+        release_buffer(&request);
+        return success;
+    }
+
+    // La propria posizione nel quiz in corso, con i giocatori vicini
+    bool show_rank = strcmp(answer, "show rank") == 0;
+    if (show_rank && state->protocol_version >= PROTOCOL_VERSION) {
+        char quiz = (char)state->current_quiz;
+        msg.type = MSG_REQUEST_RANK;
+        msg.length = 1;
+        msg.payload = &quiz;
+        return send_to_server(state, &msg) >= 0;
+    }
+
+    // Un server v1 non conosce pagine e posizioni: riceve la richiesta della classifica completa
+    if (strcmp(answer, "show score") == 0 || show_top || show_rank) {
+        if (state->protocol_version >= PROTOCOL_VERSION) {
+            char encoded[5];
+            prepare_score_request(state, &msg, encoded);
+            return send_to_server(state, &msg) >= 0;
+        }
+        msg.type = MSG_REQUEST_SCORE;
+        msg.length = strlen("show score");
         msg.payload = malloc(msg.length + 1);
         if (!msg.payload) return false;
-        strcpy(msg.payload, answer);
-        bool success = send_message(state->socket, &msg) >= 0;
+        strcpy(msg.payload, "show score");
+        bool success = send_to_server(state, &msg) >= 0;
         free(msg.payload);
         return success;
     }
@@ -370,10 +917,10 @@ bool handle_special_commands(ClientState* state, const char* answer) {
         if (!msg.payload) return false;
         
         strcpy(msg.payload, answer);
-        send_message(state->socket, &msg);
+        send_to_server(state, &msg);
         free(msg.payload);
 
-        if (receive_message(state->socket, &msg) >= 0) {
+        if (receive_server_message(state, &msg) >= 0) {
             printf("%s\n", msg.payload);
             free(msg.payload);
         }
@@ -385,10 +932,40 @@ bool handle_special_commands(ClientState* state, const char* answer) {
     return false;  // Non è un comando speciale, errore
 }
 
+/**
+ * Riceve e mostra le classifiche richieste in pipeline con le risposte precedenti
+ * @param state struttura ClientState
+ * @return true se le classifiche sono state ricevute, false altrimenti
+ * @note Il server risponde nell'ordine delle richieste: la classifica segue il
+ * risultato e il messaggio successivo (domanda o lista dei quiz)
+ */
+static bool receive_pipelined_scores(ClientState* state) {
+    while (state->pending_scores > 0) {
+        Message msg;
+        if (receive_server_message(state, &msg) < 0) return false;
+
+        bool is_score = msg.type == MSG_SCORE;
+        if (is_score) {
+            printf("\n%s\n", msg.payload);
+            state->pending_scores--;
+        } else {
+            printf("Messaggio inaspettato dal server (tipo: %s)\n",
+                   message_type_to_string(msg.type));
+        }
+        free(msg.payload);
+        if (!is_score) return false;
+    }
+    return true;
+}
+
 bool answer_question(ClientState* state, const char* question) {
     char answer[MAX_ANSWER_LENGTH];
     bool valid_input = false;
 
+    if (!receive_pipelined_scores(state)) {
+        return false;
+    }
+
     printf("%s\n", question);
 
     while (!valid_input) {
@@ -432,6 +1009,8 @@ bool handle_game_message(ClientState* state, Message* msg, char* current_questio
             break;
             
         case MSG_SCORE:
+        case MSG_SCORE_PAGE:
+        case MSG_RANK:
             printf("\n%s\n", msg->payload);
             if (!answer_question(state, current_question)) {
                 return false;
@@ -439,6 +1018,9 @@ bool handle_game_message(ClientState* state, Message* msg, char* current_questio
             break;
             
         case MSG_QUIZ_AVAILABLE:
+            if (!receive_pipelined_scores(state)) {
+                return false;
+            }
             printf("\n%s", msg->payload);
             if (!handle_user_quiz_selection(state)) {
                 return false;
@@ -453,10 +1035,14 @@ bool handle_game_message(ClientState* state, Message* msg, char* current_questio
                 return false;
             }
 
-            quiz_msg.payload[0] = state->current_quiz + '0';
+            // v2 invia il numero del quiz come byte, v1 come carattere
+            quiz_msg.payload[0] = state->protocol_version >= PROTOCOL_VERSION ?
+                                  state->current_quiz : state->current_quiz + '0';
             quiz_msg.payload[1] = '\0';
             
-            if (send_message(state->socket, &quiz_msg) < 0) {
+            bool sent = send_to_server(state, &quiz_msg) >= 0;
+            free(quiz_msg.payload);
+            if (!sent) {
                 printf("Server disconnesso durante l'invio della scelta del quiz\n");
                 return false;
             }
@@ -464,10 +1050,15 @@ bool handle_game_message(ClientState* state, Message* msg, char* current_questio
             
         case MSG_ERROR:
             printf("\nErrore: %s\n", msg->payload);
-            return false;
+            // Una richiesta fatta durante una domanda non termina il quiz
+            if (current_question[0] == '\0' || !answer_question(state, current_question)) {
+                return false;
+            }
+            break;
             
         case MSG_QUIZ_COMPLETED:
             printf("\n%s\n", msg->payload);
+            current_question[0] = '\0';
             break;
             
         case MSG_TRIVIA_COMPLETED:
@@ -495,12 +1086,15 @@ bool play_game_session(ClientState* state) {
     char current_question[MAX_QUESTION_LENGTH] = {0};
 
     while (state->current_question <= QUESTIONS_PER_GAME) {
-        if (receive_message(state->socket, &msg) < 0) {
+        if (receive_server_message(state, &msg) < 0) {
             printf("Server disconnesso durante la sessione di gioco\n");
             return false;
         }
 
-        if (!handle_game_message(state, &msg, current_question)) {
+        // Il testo della domanda viene copiato in current_question, il payload si può liberare
+        bool handled = handle_game_message(state, &msg, current_question);
+        free(msg.payload);
+        if (!handled) {
             return false;
         }
     }
@@ -519,10 +1113,14 @@ void disconnect_from_server(ClientState* state) {
         msg.length = 0;
         msg.payload = NULL;
         
-        send_message(state->socket, &msg);
+        send_to_server(state, &msg);
         
         close(state->socket);
         state->socket = -1;
+
+        // Un messaggio non ancora letto appartiene alla connessione chiusa
+        free(state->next_buffer);
+        state->next_buffer = NULL;
     }
 }
 
@@ -545,8 +1143,9 @@ bool handle_game_session(ClientState* state) {
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Utilizzo: %s <porta>\n", argv[0]);
+    bool pipeline = argc == 3 && strcmp(argv[2], "--pipeline") == 0;
+    if (argc != 2 && !pipeline) {
+        fprintf(stderr, "Utilizzo: %s <porta> [--pipeline]\n", argv[0]);
         return 1;
     }
 
@@ -555,6 +1154,7 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "Errore nell'inizializzazione del client\n");
         return 1;
     }
+    state->pipeline = pipeline;
 
     int choice;
     do {
@@ -15,6 +15,9 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <netinet/tcp.h>
 
 int create_socket() {
     // SOCK_STREAM --> TCP socket
@@ -59,74 +62,202 @@ int setup_connection(const char* ip, int port) {
     return sock;
 }
 
-ssize_t send_message(int sock, Message* msg) {
-    if (!msg) return ERR_SEND;
-    
-    // Creiamo una struttura temporanea per la conversione
+bool set_nonblocking(int sock) {
+    int flags = fcntl(sock, F_GETFL, 0);
+    if (flags < 0) return false;
+    return fcntl(sock, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+bool set_nodelay(int sock) {
+    int opt = 1;
+    return setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt)) == 0;
+}
+
+size_t encode_message_header(const Message* msg, int version, char* out) {
+    if (version >= PROTOCOL_VERSION) {
+        return encode_header_v2((uint8_t)msg->type, 0, (uint32_t)msg->length, out);
+    }
 
     // La conversione host-to-network non serve per MessageType
     // perché è un discriminatore confrontato come intero
     // non un valore usato in calcoli numerici come length
-    struct {
-        MessageType type;
-        uint32_t length;
-    } network_header;
-    
+    NetworkHeader network_header;
     network_header.type = msg->type;           // Il type rimane invariato
     network_header.length = htonl(msg->length); // Solo length viene convertito
-    
-    ssize_t header_size = sizeof(network_header);
-    ssize_t sent = send(sock, &network_header, header_size, MSG_NOSIGNAL);
-    if (sent != header_size) {
-        return ERR_SEND;
+
+    memcpy(out, &network_header, sizeof(network_header));
+    return sizeof(network_header);
+}
+
+ssize_t send_message(int sock, Message* msg, int version) {
+    if (!msg) return ERR_SEND;
+    return send_messages(sock, msg, 1, version);
+}
+
+ssize_t send_messages(int sock, Message* msgs, int count, int version) {
+    if (!msgs || count <= 0 || count > MAX_BATCH_MESSAGES) return ERR_SEND;
+
+    // Buffer temporanei per gli header, abbastanza grandi per entrambe le versioni
+    NetworkHeader network_headers[MAX_BATCH_MESSAGES];
+
+    /*
+        Header e payload partono con un'unica sendmsg (scatter/gather):
+        inviarli con send separate moltiplica le system call e,
+        con l'algoritmo di Nagle, il payload può restare in attesa
+        dell'ACK ritardato dell'header
+     */
+    struct iovec iov[2 * MAX_BATCH_MESSAGES];
+    int iov_count = 0;
+    ssize_t total = 0;
+    for (int i = 0; i < count; i++) {
+        size_t header_size = encode_message_header(&msgs[i], version, (char*)&network_headers[i]);
+        iov[iov_count].iov_base = &network_headers[i];
+        iov[iov_count++].iov_len = header_size;
+        total += header_size;
+
+        if (msgs[i].length > 0) {
+            iov[iov_count].iov_base = msgs[i].payload;
+            iov[iov_count++].iov_len = msgs[i].length;
+            total += msgs[i].length;
+        }
     }
-    
-    // Poi invia il payload sse è presente
-    if (msg->length > 0) {
-        sent = send(sock, msg->payload, msg->length, MSG_NOSIGNAL);
-        if (sent != msg->length) {
-            return ERR_SEND;
+
+    struct msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_iov = iov;
+    hdr.msg_iovlen = iov_count;
+
+    ssize_t sent_total = 0;
+    while (sent_total < total) {
+        ssize_t sent = sendmsg(sock, &hdr, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return ERR_SEND;
+        sent_total += sent;
+
+        // Invio parziale: si avanzano i vettori oltre i byte già inviati
+        while (hdr.msg_iovlen > 0 && (size_t)sent >= hdr.msg_iov->iov_len) {
+            sent -= hdr.msg_iov->iov_len;
+            hdr.msg_iov++;
+            hdr.msg_iovlen--;
+        }
+        if (hdr.msg_iovlen > 0) {
+            hdr.msg_iov->iov_base = (char*)hdr.msg_iov->iov_base + sent;
+            hdr.msg_iov->iov_len -= sent;
         }
     }
 
-    /*
-        Si divide l'invio del messaggio in due parti con
-        l'header che viene inviato prima del payload perchè
-        contiene metadati importanti che influenzano
-        come il payload deve essere processato
-     */
-    
-    DEBUG_PRINT("Inviato messaggio di tipo %s, lunghezza %d, payload (primi 10 caratteri): %.20s\n", 
-           message_type_to_string(msg->type), msg->length, msg->payload);
+    for (int i = 0; i < count; i++) {
+        DEBUG_PRINT("Inviato messaggio di tipo %s, lunghezza %d, payload (primi 10 caratteri): %.20s\n",
+               message_type_to_string(msgs[i].type), msgs[i].length, msgs[i].payload);
+    }
 
-    return sent + header_size;
+    return sent_total;
 }
 
-ssize_t receive_message(int sock, Message* msg) {
-    if (!msg) return ERR_RECV;
-    
-    struct {
-        MessageType type;
-        uint32_t length;
-    } network_header;
-    
-    ssize_t header_size = sizeof(network_header);
-    ssize_t received = recv(sock, &network_header, header_size, 0);
-    if (received <= 0) {
+/**
+ * Riceve un header v2 dal socket
+ * @param sock file descriptor del socket
+ * @param msg messaggio in cui salvare tipo e lunghezza
+ * @param flags destinazione dei flag dell'header
+ * @return numero di byte dell'header o ERR_RECV in caso di errore
+ * @note Un header v2 è lungo almeno 3 byte: si leggono quelli e poi
+ * un byte alla volta il resto del varint, senza consumare il payload
+ */
+static ssize_t receive_header_v2(int sock, Message* msg, uint8_t* flags) {
+    char header[PROTOCOL_MAX_HEADER_SIZE];
+    ssize_t header_size = 3;
+    if (recv(sock, header, header_size, MSG_WAITALL) != header_size) {
         return ERR_RECV;
     }
+
+    uint32_t length;
+    int consumed;
+    while ((consumed = decode_varint(header + 2, header_size - 2, &length)) == 0) {
+        if (header_size == PROTOCOL_MAX_HEADER_SIZE ||
+            recv(sock, header + header_size, 1, MSG_WAITALL) != 1) {
+            return ERR_RECV;
+        }
+        header_size++;
+    }
+    if (consumed < 0 || length > MAX_PAYLOAD_LENGTH) return ERR_RECV;
+
+    msg->type = (uint8_t)header[0];
+    msg->length = length;
+    *flags = (uint8_t)header[1];
+    return header_size;
+}
+
+/**
+ * Riceve i frame v2 che proseguono un messaggio e ne accoda i payload
+ * @param sock file descriptor del socket
+ * @param msg messaggio già ricevuto, con il payload allocato
+ * @param flags flag dell'ultimo frame ricevuto
+ * @return numero di byte ricevuti o ERR_RECV in caso di errore
+ * @note In caso di errore il payload di msg viene liberato
+ */
+static ssize_t receive_continuation_v2(int sock, Message* msg, uint8_t flags) {
+    ssize_t received = 0;
+
+    while (flags & MSG_FLAG_MORE) {
+        Message part;
+        ssize_t header_size = receive_header_v2(sock, &part, &flags);
+        if (header_size < 0 || part.type != msg->type ||
+            (size_t)msg->length + part.length > MAX_STREAM_LENGTH) {
+            free(msg->payload);
+            return ERR_RECV;
+        }
+
+        char* payload = realloc(msg->payload, msg->length + part.length + 1);
+        if (!payload) {
+            free(msg->payload);
+            return ERR_RECV;
+        }
+        msg->payload = payload;
+
+        if (part.length > 0 &&
+            recv(sock, msg->payload + msg->length, part.length, MSG_WAITALL) != part.length) {
+            free(msg->payload);
+            return ERR_RECV;
+        }
+        msg->length += part.length;
+        msg->payload[msg->length] = '\0';
+        received += header_size + part.length;
+    }
+    return received;
+}
+
+ssize_t receive_message(int sock, Message* msg, int version) {
+    if (!msg) return ERR_RECV;
     
-    msg->type = network_header.type;
-    msg->length = ntohl(network_header.length);  // Convertiamo solo length
+    ssize_t header_size;
+    ssize_t received;
+    uint8_t flags = 0;
+    if (version >= PROTOCOL_VERSION) {
+        header_size = receive_header_v2(sock, msg, &flags);
+        if (header_size < 0) return ERR_RECV;
+    } else {
+        NetworkHeader network_header;
+
+        header_size = sizeof(network_header);
+        // MSG_WAITALL evita di interpretare come completo un header arrivato a metà
+        received = recv(sock, &network_header, header_size, MSG_WAITALL);
+        if (received != header_size) {
+            return ERR_RECV;
+        }
+
+        msg->type = network_header.type;
+        msg->length = ntohl(network_header.length);  // Convertiamo solo length
+    }
+    received = 0;
     
     // Poi ricevo il payload sse presente
-    if (msg->length > 0) {
+    if (msg->length > 0 || (flags & MSG_FLAG_MORE)) {
         msg->payload = malloc(msg->length + 1);
         if (!msg->payload) {
             return ERR_RECV;
         }
-        received = recv(sock, msg->payload, msg->length, 0);
-        if (received <= 0) {
+        received = recv(sock, msg->payload, msg->length, MSG_WAITALL);
+        if (received != msg->length) {
             free(msg->payload);
             return ERR_RECV;
         }
@@ -135,12 +266,69 @@ ssize_t receive_message(int sock, Message* msg) {
         msg->payload = NULL;
     }
 
+    // Una classifica divisa in più frame arriva al chiamante come un unico messaggio
+    if (flags & MSG_FLAG_MORE) {
+        ssize_t continued = receive_continuation_v2(sock, msg, flags);
+        if (continued < 0) return ERR_RECV;
+        received += continued;
+    }
+
     DEBUG_PRINT("Ricevuto messaggio di tipo %s, lunghezza %d, payload (primi 10 caratteri): %.20s\n", 
            message_type_to_string(msg->type), msg->length, msg->payload);
     
     return received + header_size;
 }
 
+ssize_t parse_message(const char* data, size_t length, Message* msg, int version) {
+    if (!data || !msg) return ERR_RECV;
+
+    size_t header_size;
+    uint32_t payload_length;
+    MessageType type;
+    if (version >= PROTOCOL_VERSION) {
+        if (length < 3) {
+            return 0;  // Header non ancora completo
+        }
+        int consumed = decode_varint(data + 2, length - 2, &payload_length);
+        if (consumed == 0) return 0;
+        if (consumed < 0) return ERR_RECV;
+
+        header_size = 2 + consumed;
+        type = (uint8_t)data[0];
+    } else {
+        NetworkHeader network_header;
+        if (length < sizeof(network_header)) {
+            return 0;  // Header non ancora completo
+        }
+
+        memcpy(&network_header, data, sizeof(network_header));
+        header_size = sizeof(network_header);
+        payload_length = ntohl(network_header.length);
+        type = network_header.type;
+    }
+
+    // Una lunghezza fuori misura indica un client malevolo o desincronizzato
+    if (payload_length > MAX_PAYLOAD_LENGTH) {
+        return ERR_RECV;
+    }
+
+    if (length < header_size + payload_length) {
+        return 0;  // Payload non ancora completo
+    }
+
+    msg->type = type;
+    msg->length = payload_length;
+
+    // Il payload è una vista sui byte ricevuti: nessuna allocazione per messaggio
+    msg->payload = (char*)data + header_size;
+
+    DEBUG_PRINT("Estratto messaggio di tipo %s, lunghezza %d, payload (primi 10 caratteri): %.*s\n",
+           message_type_to_string(msg->type), msg->length,
+           (int)(payload_length < 20 ? payload_length : 20), msg->payload);
+
+    return header_size + payload_length;
+}
+
 const char* message_type_to_string(MessageType type) {
     switch(type) {
         case MSG_LOGIN: return "MSG_LOGIN";
@@ -160,6 +348,20 @@ const char* message_type_to_string(MessageType type) {
         case MSG_END_QUIZ: return "MSG_END_QUIZ";
         case MSG_DISCONNECT: return "MSG_DISCONNECT";
         case MSG_ERROR: return "MSG_ERROR";
+        case MSG_VERSION: return "MSG_VERSION";
+        case MSG_ANSWER_NEXT: return "MSG_ANSWER_NEXT";
+        case MSG_SCORE_PAGE: return "MSG_SCORE_PAGE";
+        case MSG_REQUEST_RANK: return "MSG_REQUEST_RANK";
+        case MSG_RANK: return "MSG_RANK";
         default: return "UNKNOWN"; // Messaggio sconosciuto
     }
-}
\ No newline at end of file
+}
+
+uint32_t hash_nickname(const char* nickname, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)nickname[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
@@ -0,0 +1,85 @@
+/*
+ * event_loop.c
+ * Implementazione del ciclo di eventi del server per 'Trivia Quiz Multiplayer'
+ *
+ * Questo file incapsula epoll dietro una piccola interfaccia usata dal server
+ * per registrare i socket e attendere quelli pronti. Rispetto a select() il
+ * costo di ogni risveglio è proporzionale ai soli descrittori pronti e non al
+ * descrittore più alto, e non esiste il tetto di FD_SETSIZE connessioni.
+ */
+
+#include "include/event_loop.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+EventLoop* create_event_loop(int max_events) {
+    EventLoop* loop = malloc(sizeof(EventLoop));
+    if (!loop) return NULL;
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0) {
+        perror("Errore nella creazione dell'istanza epoll");
+        free(loop);
+        return NULL;
+    }
+
+    loop->events = malloc(sizeof(struct epoll_event) * max_events);
+    if (!loop->events) {
+        close(loop->epoll_fd);
+        free(loop);
+        return NULL;
+    }
+
+    loop->max_events = max_events;
+    return loop;
+}
+
+void free_event_loop(EventLoop* loop) {
+    if (loop) {
+        close(loop->epoll_fd);
+        free(loop->events);
+        free(loop);
+    }
+}
+
+/**
+ * Esegue epoll_ctl per un descrittore
+ * @param loop ciclo di eventi
+ * @param op operazione (EPOLL_CTL_ADD o EPOLL_CTL_MOD)
+ * @param fd descrittore
+ * @param events maschera di eventi
+ * @param token valore associato agli eventi del descrittore
+ * @return true se l'operazione ha successo, false altrimenti
+ */
+static bool event_loop_ctl(EventLoop* loop, int op, int fd, uint32_t events, uint64_t token) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u64 = token;
+
+    return epoll_ctl(loop->epoll_fd, op, fd, &ev) == 0;
+}
+
+bool event_loop_add(EventLoop* loop, int fd, uint32_t events, uint64_t token) {
+    return event_loop_ctl(loop, EPOLL_CTL_ADD, fd, events, token);
+}
+
+bool event_loop_modify(EventLoop* loop, int fd, uint32_t events, uint64_t token) {
+    return event_loop_ctl(loop, EPOLL_CTL_MOD, fd, events, token);
+}
+
+void event_loop_remove(EventLoop* loop, int fd) {
+    // Dal kernel 2.6.9 l'evento può essere NULL per EPOLL_CTL_DEL
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+int event_loop_wait(EventLoop* loop, int timeout_ms) {
+    int ready = epoll_wait(loop->epoll_fd, loop->events, loop->max_events, timeout_ms);
+    if (ready < 0 && errno == EINTR) {
+        return 0;
+    }
+    return ready;
+}
@@ -0,0 +1,249 @@
+/*
+ * leaderboard.c
+ * Implementazione della classifica ordinata per 'Trivia Quiz Multiplayer'
+ *
+ * Il punteggio di un quiz va da 0 a QUESTIONS_PER_QUIZ, quindi la classifica
+ * è un counting sort sempre aggiornato: una lista di voci per ogni punteggio
+ * possibile. La posizione di un punteggio è la somma dei bucket più alti e
+ * l'elenco ordinato si ottiene visitando i bucket dal punteggio più alto.
+ *
+ * Quasi tutti i giocatori finiscono in pochi bucket, quindi ogni bucket tiene
+ * anche un treap implicito delle sue voci: la dimensione dei sottoalberi porta
+ * alla voce in una certa posizione in O(log n) attesi. Le voci entrano sempre
+ * in coda al bucket, quindi l'inserimento scende solo lungo il bordo destro.
+ */
+
+#include "include/leaderboard.h"
+#include <assert.h>
+#include <string.h>
+
+/**
+ * Restituisce il bucket di un punteggio
+ * @param board Leaderboard* della voce
+ * @param score punteggio, da 0 a QUESTIONS_PER_QUIZ
+ * @return bucket del punteggio
+ * @note Un punteggio fuori intervallo non ha un bucket: finire in quello più
+ * vicino lo metterebbe in ordine di arrivo tra i pari merito, quindi
+ * insert e update lo rifiutano prima di arrivare qui
+ */
+static LeaderboardBucket* bucket_for(const Leaderboard* board, int score) {
+    assert(score >= 0 && score < LEADERBOARD_BUCKETS);
+    return (LeaderboardBucket*)&board->buckets[score];
+}
+
+/**
+ * Restituisce il numero di voci di un sottoalbero
+ * @param node radice del sottoalbero, anche NULL
+ * @return numero di voci
+ */
+static int subtree_size(const LeaderboardNode* node) {
+    return node ? node->size : 0;
+}
+
+/**
+ * Estrae la priorità di una voce
+ * @param board Leaderboard* con lo stato del generatore
+ * @return priorità casuale
+ */
+static uint32_t random_priority(Leaderboard* board) {
+    // xorshift32: basta una sequenza ben distribuita, non serve sicurezza
+    board->seed ^= board->seed << 13;
+    board->seed ^= board->seed >> 17;
+    board->seed ^= board->seed << 5;
+    return board->seed;
+}
+
+/**
+ * Unisce due treap in cui tutte le voci di left precedono quelle di right
+ * @param left primo treap, anche vuoto
+ * @param right secondo treap, anche vuoto
+ * @return radice del treap risultante, con parent da impostare al chiamante
+ */
+static LeaderboardNode* merge_subtrees(LeaderboardNode* left, LeaderboardNode* right) {
+    if (!left) return right;
+    if (!right) return left;
+
+    if (left->priority >= right->priority) {
+        left->right = merge_subtrees(left->right, right);
+        left->right->parent = left;
+        left->size = subtree_size(left->left) + subtree_size(left->right) + 1;
+        return left;
+    }
+    right->left = merge_subtrees(left, right->left);
+    right->left->parent = right;
+    right->size = subtree_size(right->left) + subtree_size(right->right) + 1;
+    return right;
+}
+
+/**
+ * Aggiunge una voce in coda al bucket del suo punteggio
+ * @param board Leaderboard* di destinazione
+ * @param node voce con il punteggio già impostato
+ */
+static void link_node(Leaderboard* board, LeaderboardNode* node) {
+    LeaderboardBucket* bucket = bucket_for(board, node->score);
+
+    // La voce è l'ultima del bucket: prende il posto del primo nodo del bordo
+    // destro con priorità minore, che diventa il suo sottoalbero sinistro
+    node->priority = random_priority(board);
+    node->parent = NULL;
+    node->right = NULL;
+    LeaderboardNode* below = bucket->root;
+    while (below && below->priority >= node->priority) {
+        below->size++;
+        node->parent = below;
+        below = below->right;
+    }
+    node->left = below;
+    node->size = subtree_size(below) + 1;
+    if (below) below->parent = node;
+    if (node->parent) {
+        node->parent->right = node;
+    } else {
+        bucket->root = node;
+    }
+
+    node->prev = bucket->last;
+    node->next = NULL;
+    if (bucket->last) {
+        bucket->last->next = node;
+    } else {
+        bucket->first = node;
+    }
+    bucket->last = node;
+    bucket->count++;
+    board->count++;
+}
+
+/**
+ * Stacca una voce dal bucket del suo punteggio senza liberarla
+ * @param board Leaderboard* che contiene la voce
+ * @param node voce da staccare
+ */
+static void unlink_node(Leaderboard* board, LeaderboardNode* node) {
+    LeaderboardBucket* bucket = bucket_for(board, node->score);
+
+    // I figli prendono il posto della voce e gli antenati perdono una voce
+    LeaderboardNode* parent = node->parent;
+    LeaderboardNode* child = merge_subtrees(node->left, node->right);
+    if (child) child->parent = parent;
+    if (!parent) {
+        bucket->root = child;
+    } else if (parent->left == node) {
+        parent->left = child;
+    } else {
+        parent->right = child;
+    }
+    for (; parent; parent = parent->parent) {
+        parent->size--;
+    }
+    node->parent = NULL;
+    node->left = NULL;
+    node->right = NULL;
+
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        bucket->first = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        bucket->last = node->prev;
+    }
+    node->prev = NULL;
+    node->next = NULL;
+    bucket->count--;
+    board->count--;
+}
+
+void init_leaderboard(Leaderboard* board) {
+    memset(board, 0, sizeof(Leaderboard));
+    board->seed = 0x9E3779B9;
+}
+
+void free_leaderboard(Leaderboard* board) {
+    init_leaderboard(board);
+}
+
+bool leaderboard_insert(Leaderboard* board, LeaderboardNode* node, const char* nickname, int score) {
+    if (score < 0 || score >= LEADERBOARD_BUCKETS) return false;
+
+    node->nickname = nickname;
+    node->score = score;
+    link_node(board, node);
+    return true;
+}
+
+void leaderboard_remove(Leaderboard* board, LeaderboardNode* node) {
+    unlink_node(board, node);
+}
+
+bool leaderboard_update(Leaderboard* board, LeaderboardNode* node, int score) {
+    if (score < 0 || score >= LEADERBOARD_BUCKETS) return false;
+    if (node->score == score) return true;
+
+    unlink_node(board, node);
+    node->score = score;
+    link_node(board, node);
+    return true;
+}
+
+int leaderboard_rank(const Leaderboard* board, int score) {
+    if (score >= LEADERBOARD_BUCKETS) return 0;
+    if (score < 0) return board->count;
+
+    const LeaderboardBucket* bucket = bucket_for(board, score);
+    int rank = 0;
+    for (const LeaderboardBucket* b = &board->buckets[LEADERBOARD_BUCKETS - 1]; b > bucket; b--) {
+        rank += b->count;
+    }
+    return rank;
+}
+
+const LeaderboardNode* leaderboard_at(const Leaderboard* board, int position) {
+    if (position < 0 || position >= board->count) return NULL;
+
+    // I bucket interi prima della posizione si saltano con il loro contatore
+    for (int i = LEADERBOARD_BUCKETS - 1; i >= 0; i--) {
+        const LeaderboardBucket* bucket = &board->buckets[i];
+        if (position >= bucket->count) {
+            position -= bucket->count;
+            continue;
+        }
+
+        // Dentro il bucket si scende nel treap seguendo le dimensioni dei sottoalberi
+        const LeaderboardNode* node = bucket->root;
+        while (node) {
+            int before = subtree_size(node->left);
+            if (position < before) {
+                node = node->left;
+            } else if (position > before) {
+                position -= before + 1;
+                node = node->right;
+            } else {
+                break;
+            }
+        }
+        return node;
+    }
+    return NULL;
+}
+
+const LeaderboardNode* leaderboard_next(const Leaderboard* board, const LeaderboardNode* node) {
+    if (node->next) return node->next;
+
+    for (const LeaderboardBucket* b = bucket_for(board, node->score) - 1; b >= board->buckets; b--) {
+        if (b->first) return b->first;
+    }
+    return NULL;
+}
+
+const LeaderboardNode* leaderboard_prev(const Leaderboard* board, const LeaderboardNode* node) {
+    if (node->prev) return node->prev;
+
+    for (const LeaderboardBucket* b = bucket_for(board, node->score) + 1; b < board->buckets + LEADERBOARD_BUCKETS; b++) {
+        if (b->last) return b->last;
+    }
+    return NULL;
+}
@@ -6,61 +6,350 @@
  * per gestire i giocatori, i loro punteggi e il loro stato nel gioco. Include
  * funzionalità per creare, modificare e cercare giocatori, oltre a gestire
  * l'array dinamico dei giocatori attivi.
+ *
+ * I giocatori vivono in pagine di PLAYER_PAGE_SIZE record che non vengono mai
+ * spostate, come il slab dei client del server: un Player* resta valido finché
+ * il giocatore è registrato, e i client conservano un PlayerHandle invece di
+ * cercare il giocatore per nickname a ogni messaggio. Il registro non ha un
+ * numero massimo di giocatori: cresce di una pagina alla volta senza copiare i
+ * record esistenti, e le voci delle classifiche sono contenute nei giocatori,
+ * così un giocatore costa un solo record e una voce nella tabella hash.
+ *
+ * Ogni pagina ha la propria lista di slot liberi e conta i giocatori che
+ * contiene: una pagina svuotata dalle rimozioni viene liberata, tenendone una
+ * sola vuota come riserva per non allocare e liberare ad ogni ingresso e uscita.
+ * Il suo indice resta nella tabella delle pagine, così gli slot delle altre non
+ * cambiano, e quando viene riallocata i suoi slot ripartono dalla generazione
+ * più alta che avevano raggiunto: gli handle vecchi restano non validi.
+ *
+ * I giocatori sono indicizzati per nickname in una tabella hash a indirizzamento
+ * aperto con scansione lineare. Ogni voce contiene solo lo slot del giocatore
+ * nelle pagine, e l'hash del nickname è conservato nel giocatore: allargare la
+ * tabella non richiede di ricalcolarlo e i confronti tra stringhe avvengono
+ * solo tra nickname con lo stesso hash.
  */
 
 #include "include/player.h"
+#include "include/common.h"
 #include "include/debug.h"
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * Restituisce il giocatore memorizzato in uno slot delle pagine
+ * @param array PlayerArray* che contiene le pagine
+ * @param slot indice dello slot
+ * @return Player* dello slot, registrato o libero
+ */
+static Player* slot_at(const PlayerArray* array, int slot) {
+    return &array->pages[slot / PLAYER_PAGE_SIZE].players[slot % PLAYER_PAGE_SIZE];
+}
+
+/**
+ * Restituisce lo slot della tabella hash che contiene un giocatore
+ * @param array PlayerArray* in cui cercare
+ * @param nickname nickname del giocatore
+ * @param hash hash del nickname
+ * @return slot del giocatore, o il primo slot vuoto incontrato se il giocatore non c'è
+ */
+static int find_slot(const PlayerArray* array, const char* nickname, uint32_t hash) {
+    int mask = array->index_capacity - 1;
+    int slot = hash & mask;
+    while (array->index[slot] >= 0) {
+        const Player* player = slot_at(array, array->index[slot]);
+        if (player->hash == hash && strcmp(player->nickname, nickname) == 0) break;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Ricostruisce la tabella hash con un nuovo numero di slot
+ * @param array PlayerArray* da indicizzare
+ * @param capacity nuovo numero di slot, potenza di 2 maggiore del numero di giocatori
+ * @return true se la tabella è stata ricostruita, false se l'allocazione fallisce
+ * @note Usa gli hash conservati nei giocatori: i nickname non vengono riletti
+ */
+static bool rebuild_index(PlayerArray* array, int capacity) {
+    int* index = malloc(sizeof(int) * capacity);
+    if (!index) return false;
+    memset(index, -1, sizeof(int) * capacity);
+
+    for (int i = 0; i < array->count; i++) {
+        int slot = slot_at(array, array->live[i])->hash & (capacity - 1);
+        while (index[slot] >= 0) slot = (slot + 1) & (capacity - 1);
+        index[slot] = array->live[i];
+    }
+
+    free(array->index);
+    array->index = index;
+    array->index_capacity = capacity;
+    return true;
+}
+
+/**
+ * Svuota uno slot della tabella hash
+ * @param array PlayerArray* che contiene la tabella
+ * @param slot slot da svuotare
+ * @note Le voci successive nella stessa sequenza vengono spostate indietro, così
+ * la ricerca non ha bisogno di segnaposto per gli slot liberati
+ */
+static void delete_slot(PlayerArray* array, int slot) {
+    int mask = array->index_capacity - 1;
+    int hole = slot;
+    for (int next = (slot + 1) & mask; array->index[next] >= 0; next = (next + 1) & mask) {
+        // Una voce si sposta nel buco solo se il buco è tra il suo slot ideale e lei
+        int ideal = slot_at(array, array->index[next])->hash & mask;
+        if (((next - ideal) & mask) >= ((next - hole) & mask)) {
+            array->index[hole] = array->index[next];
+            hole = next;
+        }
+    }
+    array->index[hole] = -1;
+}
+
+/**
+ * Inserisce una pagina in testa alla lista delle pagine con slot liberi
+ * @param array PlayerArray* che contiene la pagina
+ * @param index indice della pagina, non presente nella lista
+ */
+static void link_free_page(PlayerArray* array, int index) {
+    PlayerPage* page = &array->pages[index];
+    page->prev_free = -1;
+    page->next_free = array->free_page;
+    if (array->free_page >= 0) array->pages[array->free_page].prev_free = index;
+    array->free_page = index;
+}
+
+/**
+ * Stacca una pagina dalla lista delle pagine con slot liberi
+ * @param array PlayerArray* che contiene la pagina
+ * @param index indice della pagina, presente nella lista
+ */
+static void unlink_free_page(PlayerArray* array, int index) {
+    PlayerPage* page = &array->pages[index];
+    if (page->prev_free >= 0) {
+        array->pages[page->prev_free].next_free = page->next_free;
+    } else {
+        array->free_page = page->next_free;
+    }
+    if (page->next_free >= 0) array->pages[page->next_free].prev_free = page->prev_free;
+    page->prev_free = -1;
+    page->next_free = -1;
+}
+
+/**
+ * Alloca una pagina, riusando l'indice di una pagina liberata se c'è, e la
+ * inserisce nella lista delle pagine con slot liberi
+ * @param array PlayerArray* da allargare
+ * @return true se la pagina è stata allocata, false altrimenti
+ * @note Le pagine esistenti non vengono spostate, quindi i Player* (e i nickname
+ * a cui puntano le classifiche) restano validi mentre il registro cresce
+ */
+static bool grow_player_pages(PlayerArray* array) {
+    // La tabella delle pagine raddoppia, così anche con milioni di giocatori
+    // viene riallocata solo poche volte
+    if (array->released_page < 0 && array->pages_count == array->pages_capacity) {
+        int new_capacity = array->pages_capacity > 0 ? array->pages_capacity * 2 : 4;
+        PlayerPage* new_pages = realloc(array->pages, sizeof(PlayerPage) * new_capacity);
+        if (!new_pages) return false;
+        array->pages = new_pages;
+        array->pages_capacity = new_capacity;
+    }
+
+    Player* players = calloc(PLAYER_PAGE_SIZE, sizeof(Player));
+    if (!players) return false;
+
+    int index;
+    if (array->released_page >= 0) {
+        index = array->released_page;
+        array->released_page = array->pages[index].next_free;
+    } else {
+        index = array->pages_count++;
+        array->pages[index].generation = 1;
+    }
+    PlayerPage* page = &array->pages[index];
+    page->players = players;
+    page->live = 0;
+    page->free_slot = -1;
+
+    // Gli slot vengono concatenati in ordine, così i primi assegnati sono i primi della pagina
+    int first = index * PLAYER_PAGE_SIZE;
+    for (int i = PLAYER_PAGE_SIZE - 1; i >= 0; i--) {
+        players[i].slot = first + i;
+        players[i].generation = page->generation;
+        players[i].live_index = -1;
+        players[i].next_free = page->free_slot;
+        page->free_slot = first + i;
+    }
+    link_free_page(array, index);
+    return true;
+}
+
+/**
+ * Libera una pagina vuota, o la tiene come riserva se non ce n'è già una
+ * @param array PlayerArray* che contiene la pagina
+ * @param index indice della pagina, senza giocatori registrati
+ */
+static void release_player_page(PlayerArray* array, int index) {
+    if (array->spare_page < 0) {
+        array->spare_page = index;
+        return;
+    }
+
+    // Gli slot ripartiranno dalla generazione più alta: nessuno è assegnato,
+    // quindi nessun handle in circolazione la usa ancora
+    PlayerPage* page = &array->pages[index];
+    uint32_t generation = 1;
+    for (int i = 0; i < PLAYER_PAGE_SIZE; i++) {
+        if (page->players[i].generation > generation) generation = page->players[i].generation;
+    }
+
+    unlink_free_page(array, index);
+    free(page->players);
+    page->players = NULL;
+    page->free_slot = -1;
+    page->generation = generation;
+    page->next_free = array->released_page;
+    array->released_page = index;
+}
+
+/**
+ * Aggiunge un giocatore in fondo all'elenco ordinato per versione
+ * @param array PlayerArray* che contiene l'elenco
+ * @param player giocatore non presente nell'elenco
+ */
+static void link_change(PlayerArray* array, Player* player) {
+    player->older_change = array->newest_change;
+    player->newer_change = NULL;
+    if (array->newest_change) {
+        array->newest_change->newer_change = player;
+    } else {
+        array->oldest_change = player;
+    }
+    array->newest_change = player;
+}
+
+/**
+ * Stacca un giocatore dall'elenco ordinato per versione
+ * @param array PlayerArray* che contiene l'elenco
+ * @param player giocatore presente nell'elenco
+ */
+static void unlink_change(PlayerArray* array, Player* player) {
+    if (player->older_change) {
+        player->older_change->newer_change = player->newer_change;
+    } else {
+        array->oldest_change = player->newer_change;
+    }
+    if (player->newer_change) {
+        player->newer_change->older_change = player->older_change;
+    } else {
+        array->newest_change = player->older_change;
+    }
+    player->older_change = NULL;
+    player->newer_change = NULL;
+}
+
 PlayerArray* create_player_array(int initial_capacity) {
     PlayerArray* array = (PlayerArray*)malloc(sizeof(PlayerArray));
     if (!array) return NULL;
 
-    array->players = (Player*)malloc(sizeof(Player) * initial_capacity);
-    if (!array->players) {
+    array->pages = NULL;
+    array->pages_count = 0;
+    array->pages_capacity = 0;
+    array->free_page = -1;
+    array->released_page = -1;
+    array->spare_page = -1;
+    array->live = (int*)malloc(sizeof(int) * initial_capacity);
+    if (!array->live) {
         // Allocazione fallita, deallocazione e restituzione NULL
         free(array);
         return NULL;
     }
+    array->live_capacity = initial_capacity;
 
+    init_leaderboard(&array->leaderboards[0]);
+    init_leaderboard(&array->leaderboards[1]);
+
+    // La tabella resta piena al più per metà, così le sequenze di scansione sono brevi
     array->count = 0;
-    array->capacity = initial_capacity;
+    array->index = NULL;
+    int index_capacity = 16;
+    while (index_capacity < initial_capacity * 2) index_capacity *= 2;
+    if (!rebuild_index(array, index_capacity)) {
+        free(array->live);
+        free(array);
+        return NULL;
+    }
+
+    if (pthread_rwlock_init(&array->lock, NULL) != 0) {
+        free(array->index);
+        free(array->live);
+        free(array);
+        return NULL;
+    }
+
+    array->version = 0;
+    array->reset_version = 0;
+    array->oldest_change = NULL;
+    array->newest_change = NULL;
     return array;
 }
 
 void free_player_array(PlayerArray* array) {
     // Verifica che l'array non sia NULL
     if (array) {
-        free(array->players);
+        pthread_rwlock_destroy(&array->lock);
+        free_leaderboard(&array->leaderboards[0]);
+        free_leaderboard(&array->leaderboards[1]);
+        free(array->index);
+        for (int i = 0; i < array->pages_count; i++) {
+            free(array->pages[i].players);
+        }
+        free(array->pages);
+        free(array->live);
         free(array);
     }
 }
 
-bool add_player(PlayerArray* array, const char* nickname) {
-    if (!array || !nickname) return false;
-    DEBUG_PRINT("Aggiungendo il giocatore: %s", nickname);
+void lock_players_read(PlayerArray* array) {
+    pthread_rwlock_rdlock(&array->lock);
+}
 
-    // Verifica che non ci siano troppi giocatori
-    if (array->count >= MAX_PLAYERS) {
-        return false;
-    }
+void lock_players_write(PlayerArray* array) {
+    pthread_rwlock_wrlock(&array->lock);
+}
+
+void unlock_players(PlayerArray* array) {
+    pthread_rwlock_unlock(&array->lock);
+}
+
+Player* add_player(PlayerArray* array, const char* nickname) {
+    if (!array || !nickname) return NULL;
+    DEBUG_PRINT("Aggiungendo il giocatore: %s", nickname);
 
     // Verifica che il giocatore non sia già presente
-    if (find_player(array, nickname) != NULL) return false;
+    if (find_player(array, nickname) != NULL) return NULL;
 
-    if (array->count >= array->capacity) {
-        int new_capacity = array->capacity * 2; // Raddoppia la capacità
-        Player* new_players = (Player*)realloc(array->players, 
-                                             sizeof(Player) * new_capacity);
+    if ((array->count + 1) * 2 > array->index_capacity &&
+        !rebuild_index(array, array->index_capacity * 2)) {
+        return NULL;
+    }
+
+    if (array->count >= array->live_capacity) {
+        int new_capacity = array->live_capacity * 2; // Raddoppia la capacità
+        int* new_live = (int*)realloc(array->live, sizeof(int) * new_capacity);
         // Verifica che la riallocazione sia andata a buon fine
-        if (!new_players) return false;
-        
-        array->players = new_players;
-        array->capacity = new_capacity;
+        if (!new_live) return NULL;
+
+        array->live = new_live;
+        array->live_capacity = new_capacity;
     }
 
-    Player* new_player = &array->players[array->count];
+    if (array->free_page < 0 && !grow_player_pages(array)) return NULL;
+    int page_index = array->free_page;
+    PlayerPage* page = &array->pages[page_index];
+    Player* new_player = slot_at(array, page->free_slot);
     // MAX_NICK_LENGTH - 1 per garantire che ci sia spazio per il carattere null terminatore '\0'
     strncpy(new_player->nickname, nickname, MAX_NICK_LENGTH - 1);
     new_player->nickname[MAX_NICK_LENGTH - 1] = '\0';
@@ -68,116 +357,130 @@ bool add_player(PlayerArray* array, const char* nickname) {
     new_player->geography_score = 0;
     new_player->completed_sport = false;
     new_player->completed_geography = false;
+    new_player->hash = hash_nickname(new_player->nickname, strlen(new_player->nickname));
 
-    array->count++;
-    return true;
-}
+    page->free_slot = new_player->next_free;
+    page->live++;
+    if (page->free_slot < 0) unlink_free_page(array, page_index);
+    if (array->spare_page == page_index) array->spare_page = -1;
 
-void reset_player_connection(PlayerArray* array, const char* nickname) {
-    if (!array || !nickname) return;
-    DEBUG_PRINT("Resettando il punteggio e lo stato di connessione del giocatore: %s",
-                nickname);
+    // Il giocatore entra in entrambe le classifiche, dopo i pari merito già presenti
+    leaderboard_insert(&array->leaderboards[0], &new_player->rankings[0], new_player->nickname, 0);
+    leaderboard_insert(&array->leaderboards[1], &new_player->rankings[1], new_player->nickname, 0);
+    link_change(array, new_player);
+    new_player->version = ++array->version;
 
-    Player* player = find_player(array, nickname);
-    if (player) {
-        player->is_connected = false;
-    }
+    new_player->is_connected = false;
+    new_player->live_index = array->count;
+    array->live[array->count++] = new_player->slot;
+    array->index[find_slot(array, new_player->nickname, new_player->hash)] = new_player->slot;
+    return new_player;
 }
 
-bool remove_player(PlayerArray* array, const char* nickname) {
-    if (!array || !nickname) return false;
+Player* player_at(const PlayerArray* array, int i) {
+    return slot_at(array, array->live[i]);
+}
 
-    for (int i = 0; i < array->count; i++) {
-        if (strcmp(array->players[i].nickname, nickname) == 0) {
-            if (i < array->count - 1) {  // Se il giocatore non è l'ultimo
-                // Sposta l'ultimo giocatore nell'array in posizione i
-                // minimizzando il numero di spostamenti
-                array->players[i] = array->players[array->count - 1];
-            }
-            array->count--;
-            return true;
-        }
-    }
-    return false;
+PlayerHandle player_handle(const Player* player) {
+    return ((uint64_t)player->generation << 32) | (uint32_t)player->slot;
 }
 
-Player* find_player(PlayerArray* array, const char* nickname) {
-    if (!array || !nickname) return NULL;
+Player* lookup_player(PlayerArray* array, PlayerHandle handle) {
+    uint32_t slot = (uint32_t)handle;
+    if (!array || slot >= (uint32_t)(array->pages_count * PLAYER_PAGE_SIZE) ||
+        !array->pages[slot / PLAYER_PAGE_SIZE].players) {
+        return NULL;
+    }
 
-    for (int i = 0; i < array->count; i++) {
-        if (strcmp(array->players[i].nickname, nickname) == 0) {
-            return &array->players[i];
-        }
+    Player* player = slot_at(array, (int)slot);
+    if (player->live_index < 0 || player->generation != (uint32_t)(handle >> 32)) return NULL;
+    return player;
+}
+
+void touch_player(PlayerArray* array, Player* player) {
+    if (array->newest_change != player) {
+        unlink_change(array, player);
+        link_change(array, player);
     }
-    return NULL;
+    player->version = ++array->version;
 }
 
-/**
- * Confronta due giocatori in base al punteggio
- * @param a const void* puntatore al primo giocatore
- * @param b const void* puntatore al secondo giocatore
- * @param sport_quiz true se si vuole ordinare i giocatori 
- * per il punteggio del quiz sullo sport, false per il quiz sulla geografia
- * @return risultato del confronto per qsort
- * (valore negativo se a < b, 0 se a == b, valore positivo se a > b)
- * @note Questa funzione è utilizzata internamente da qsort
- */
-static int compare_players_by_score(const void* a, const void* b, bool sport_quiz) {
-    const Player* player_a = (const Player*)a;
-    const Player* player_b = (const Player*)b;
-    
-    int score_a = sport_quiz ? player_a->sport_score : player_a->geography_score;
-    int score_b = sport_quiz ? player_b->sport_score : player_b->geography_score;
-    
-    return score_b - score_a;
+bool add_point(PlayerArray* array, Player* player, bool sport_quiz) {
+    int* score = sport_quiz ? &player->sport_score : &player->geography_score;
+    if (!leaderboard_update(&array->leaderboards[sport_quiz ? 0 : 1],
+                            &player->rankings[sport_quiz ? 0 : 1], *score + 1)) {
+        return false;
+    }
+    (*score)++;
+    touch_player(array, player);
+    return true;
 }
 
-/**
- * Confronta due giocatori in base al punteggio Sport
- * @param a const void* puntatore al primo giocatore
- * @param b const void* puntatore al secondo giocatore
- * @return risultato del confronto per qsort
-*/
-static int compare_sport_score(const void* a, const void* b) {
-    return compare_players_by_score(a, b, true);
+void reset_player_connection(Player* player) {
+    if (!player) return;
+    DEBUG_PRINT("Resettando lo stato di connessione del giocatore: %s", player->nickname);
+
+    player->is_connected = false;
 }
 
-/**
- * Confronta due giocatori in base al punteggio Geografia
- * @param a const void* puntatore al primo giocatore
- * @param b const void* puntatore al secondo giocatore
- * @return risultato del confronto per qsort
- */
-static int compare_geography_score(const void* a, const void* b) {
-    return compare_players_by_score(a, b, false);
+bool remove_player(PlayerArray* array, const char* nickname) {
+    if (!array || !nickname) return false;
+
+    int index_slot = find_slot(array, nickname, hash_nickname(nickname, strlen(nickname)));
+    if (array->index[index_slot] < 0) return false;
+    Player* player = slot_at(array, array->index[index_slot]);
+
+    leaderboard_remove(&array->leaderboards[0], &player->rankings[0]);
+    leaderboard_remove(&array->leaderboards[1], &player->rankings[1]);
+    delete_slot(array, index_slot);
+    unlink_change(array, player);
+
+    // L'ultimo giocatore dell'elenco prende il posto di quello rimosso,
+    // ma il suo record resta dov'è
+    int last = array->live[--array->count];
+    array->live[player->live_index] = last;
+    slot_at(array, last)->live_index = player->live_index;
+
+    // Cambiando generazione gli handle ancora in giro non raggiungono il prossimo giocatore
+    uint32_t generation = player->generation + 1;
+    player->generation = generation != 0 ? generation : 1;
+    player->live_index = -1;
+
+    // Lo slot torna libero nella sua pagina, che riprende ad accettare giocatori
+    int page_index = player->slot / PLAYER_PAGE_SIZE;
+    PlayerPage* page = &array->pages[page_index];
+    if (page->free_slot < 0) link_free_page(array, page_index);
+    player->next_free = page->free_slot;
+    page->free_slot = player->slot;
+    if (--page->live == 0) release_player_page(array, page_index);
+
+    // Una classifica incrementale non può esprimere la rimozione
+    array->reset_version = ++array->version;
+    return true;
 }
 
-void sort_players_by_score(PlayerArray* array, bool sport_quiz) {
-    if (!array || array->count <= 1) return;
+Player* find_player(PlayerArray* array, const char* nickname) {
+    if (!array || !nickname) return NULL;
 
-    // Use qsort to sort the players
-    qsort(array->players, array->count, sizeof(Player), 
-          sport_quiz ? compare_sport_score : compare_geography_score);
+    int slot = array->index[find_slot(array, nickname, hash_nickname(nickname, strlen(nickname)))];
+    return slot >= 0 ? slot_at(array, slot) : NULL;
 }
 
-bool has_completed_quiz(PlayerArray* array, const char* nickname, bool sport_quiz) {
-    Player* player = find_player(array, nickname);
-    if (!player || !nickname) return false;
-    
+bool has_completed_quiz(const Player* player, bool sport_quiz) {
+    if (!player) return false;
+
     return sport_quiz ? player->completed_sport : player->completed_geography;
 }
 
-void mark_quiz_as_completed(PlayerArray* array, const char* nickname, bool sport_quiz) {
-    Player* player = find_player(array, nickname);
-
-    if (!player || !nickname) return;
+void mark_quiz_as_completed(PlayerArray* array, Player* player, bool sport_quiz) {
+    if (!player) return;
 
     DEBUG_PRINT("Segnando per %s come completato il quiz: %s",
-                nickname, sport_quiz ? "Sport" : "Geografia");
+                player->nickname, sport_quiz ? "Sport" : "Geografia");
     
-    if (sport_quiz) {
-        player->completed_sport = true;
-    } else {
-        player->completed_geography = true;
+    bool* completed = sport_quiz ? &player->completed_sport : &player->completed_geography;
+    if (!*completed) {
+        *completed = true;
+        touch_player(array, player);
     }
 }
\ No newline at end of file
@@ -0,0 +1,122 @@
+/*
+ * protocol.c
+ * Implementazione del protocollo binario v2 per 'Trivia Quiz Multiplayer'
+ *
+ * Il protocollo v1 invia un header copiato direttamente dalla memoria, la cui
+ * dimensione dipende dalla rappresentazione dell'enum scelta dal compilatore,
+ * e payload già formattati in italiano. Il protocollo v2 usa un header compatto
+ * a larghezza fissa (con la sola lunghezza in varint) e payload strutturati:
+ * il server invia codici e dati, e il testo viene composto dal client.
+ */
+
+#include "include/protocol.h"
+#include <string.h>
+
+const char* status_text(StatusCode code) {
+    switch (code) {
+        case STATUS_NICKNAME_PROMPT: return "\nTrivia Quiz\n"
+                                            "+++++++++++++++++++++++++++++++++++++++++\n"
+                                            "Scegli un nickname (deve essere univoco): ";
+        case STATUS_LOGIN_NEW: return "Login avvenuto con successo!";
+        case STATUS_LOGIN_RETURNING: return "Bentornato! Inizia un nuovo quiz per mettere alla prova le tue conoscenze!";
+        case STATUS_LOGIN_ALL_COMPLETED: return "Hai già completato tutti i quiz disponibili! Torna presto per nuovi quiz.";
+        case STATUS_LOGIN_NICKNAME_IN_USE: return "Nickname già in uso da un altro giocatore";
+        case STATUS_LOGIN_SERVER_FULL: return "Il server ha raggiunto la massima capacità di giocatori, riprova più tardi.";
+        case STATUS_ANSWER_WRONG: return "Risposta errata!";
+        case STATUS_ANSWER_CORRECT: return "Risposta corretta!";
+        case STATUS_QUIZ_COMPLETED: return "Quiz completato!";
+        case STATUS_QUIZ_ENDED: return "Quiz terminato. Ridirezione al menu principale.";
+        case STATUS_QUIZ_UNAVAILABLE: return "Quiz non disponibile. Seleziona un quiz dalla lista.\n";
+        case STATUS_TRIVIA_COMPLETED: return "Hai completato tutti i quiz disponibili!";
+        case STATUS_SERVER_SHUTDOWN: return "Server shutdown";
+        case STATUS_QUIZ_IN_PROGRESS: return "Quiz già in corso: terminalo con endquiz prima di sceglierne un altro.";
+        case STATUS_REQUEST_FAILED: return "Richiesta non valida o non soddisfacibile.";
+        default: return "";
+    }
+}
+
+size_t encode_varint(uint32_t value, char* out) {
+    size_t written = 0;
+    while (value >= 0x80) {
+        out[written++] = (char)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out[written++] = (char)value;
+    return written;
+}
+
+int decode_varint(const char* data, size_t length, uint32_t* value) {
+    uint32_t result = 0;
+    for (size_t i = 0; i < 5; i++) {
+        if (i >= length) return 0;  // Varint non ancora completo
+
+        uint8_t byte = (uint8_t)data[i];
+        result |= (uint32_t)(byte & 0x7F) << (7 * i);
+        if (!(byte & 0x80)) {
+            *value = result;
+            return (int)i + 1;
+        }
+    }
+    return -1;
+}
+
+size_t encode_header_v2(uint8_t type, uint8_t flags, uint32_t length, char* out) {
+    out[0] = (char)type;
+    out[1] = (char)flags;
+    return 2 + encode_varint(length, out + 2);
+}
+
+bool append_u8(ByteBuffer* buffer, uint8_t value) {
+    return append_to_buffer(buffer, &value, 1);
+}
+
+bool append_varint(ByteBuffer* buffer, uint32_t value) {
+    char encoded[5];
+    return append_to_buffer(buffer, encoded, encode_varint(value, encoded));
+}
+
+bool append_string(ByteBuffer* buffer, const char* text, size_t length) {
+    return append_varint(buffer, (uint32_t)length) &&
+           (length == 0 || append_to_buffer(buffer, text, length));
+}
+
+void init_payload_reader(PayloadReader* reader, const char* data, size_t length) {
+    reader->data = data;
+    reader->length = data ? length : 0;
+    reader->offset = 0;
+    reader->error = false;
+}
+
+uint8_t read_u8(PayloadReader* reader) {
+    if (reader->error || reader->offset >= reader->length) {
+        reader->error = true;
+        return 0;
+    }
+    return (uint8_t)reader->data[reader->offset++];
+}
+
+uint32_t read_varint(PayloadReader* reader) {
+    uint32_t value = 0;
+    int consumed = reader->error ? -1 :
+                   decode_varint(reader->data + reader->offset, reader->length - reader->offset, &value);
+    if (consumed <= 0) {
+        reader->error = true;
+        return 0;
+    }
+    reader->offset += consumed;
+    return value;
+}
+
+const char* read_string(PayloadReader* reader, size_t* length) {
+    uint32_t text_length = read_varint(reader);
+    if (reader->error || text_length > reader->length - reader->offset) {
+        reader->error = true;
+        *length = 0;
+        return NULL;
+    }
+
+    const char* text = reader->data + reader->offset;
+    reader->offset += text_length;
+    *length = text_length;
+    return text;
+}
@@ -6,129 +6,381 @@
  * e la visualizzazione dei punteggi dei giocatori. Gestisce la creazione
  * di report dettagliati che includono i punteggi per ogni categoria di quiz
  * e lo stato di completamento dei quiz per ogni giocatore.
+ *
+ * La classifica completa viene prodotta una sola volta per ogni versione dei
+ * giocatori e conservata in una cache condivisa da tutti i worker: finché
+ * nessun punteggio cambia, ogni richiesta si limita a copiarla.
  */
 
 #include "include/score.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Byte massimi di una voce v2: il nickname con la sua lunghezza, i due punteggi
+// (al più QUESTIONS_PER_QUIZ, quindi un byte di varint ciascuno) e i flag
+#define SCORE_ENTRY_MAX_SIZE (1 + (MAX_NICK_LENGTH) + 2 + 1)
+// Byte massimi dell'intestazione v2: versione, flag e numero voci
+#define SCORE_HEADER_MAX_SIZE (5 + 1 + 5)
+
+// Ultima classifica prodotta per ogni formato, condivisa da tutti i worker
+static RenderedScoreboard* scoreboard_cache[SCOREBOARD_FORMATS];
+
+// Protegge la cache e i contatori dei riferimenti: non è mai tenuto durante una produzione
+static pthread_mutex_t scoreboard_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Uno per formato, serializza le sole produzioni: chi trova la classifica
+// aggiornata in cache non lo acquisisce
+static pthread_mutex_t scoreboard_render_locks[SCOREBOARD_FORMATS] = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER
+};
+
 /**
- * Formatta la sezione dei partecipanti in una stringa
+ * Formatta la sezione dei partecipanti
  * @param state puntatore allo stato del server
- * @param buffer buffer di output
- * @param offset offset attuale del buffer
+ * @param out ByteBuffer* in cui aggiungere il testo
+ * @return true se il testo è stato aggiunto, false se l'allocazione fallisce
  * @note Aggiunge i nomi dei partecipanti al buffer.
  * @note Se non ci sono partecipanti, aggiunge un messaggio di avviso.
  */
-static void format_participants_section(const ServerState* state, char* buffer, int* offset, size_t buf_size) {
-    *offset += snprintf(buffer + *offset, buf_size - *offset, "\nPartecipanti (%d):\n", state->players->count);
+static bool format_participants_section(const ServerState* state, ByteBuffer* out) {
+    if (!append_format(out, "\nPartecipanti (%d):\n", state->players->count)) return false;
 
     if (state->players->count == 0) {
-        *offset += snprintf(buffer + *offset, buf_size - *offset,
-                            "Nessun giocatore presente\n");
-        return;
+        return append_format(out, "Nessun giocatore presente\n");
     }
     
     for (int i = 0; i < state->players->count; i++) {
-        *offset += snprintf(buffer + *offset, buf_size - *offset, 
-                            "- %s\n", state->players->players[i].nickname);
+        if (!append_format(out, "- %s\n", player_at(state->players, i)->nickname)) return false;
     }
+    return true;
 }
 
 /**
- * Ordina i giocatori in base al punteggio
- * @param players array di giocatori
- * @param buffer buffer di output
- * @param offset offset attuale del buffer
- * @param is_sport_quiz true se si vuole ordinare i giocatori
- * per il punteggio del quiz sullo sport, false per il quiz Geografia
- * @note Utilizza qsort per ordinare i giocatori in base al punteggio.
+ * Formatta la classifica di un quiz
+ * @param state puntatore allo stato del server
+ * @param out ByteBuffer* in cui aggiungere il testo
+ * @param is_sport_quiz true per la classifica del quiz sullo sport, false per il quiz Geografia
+ * @return true se il testo è stato aggiunto, false se l'allocazione fallisce
+ * @note Le voci vengono lette in ordine dalla classifica del quiz, già
+ * ordinata ad ogni cambio di punteggio: non serve ordinare i giocatori.
  */
-static void format_quiz_scores(const ServerState* state, char* buffer, int* offset, 
-                                bool is_sport_quiz, size_t buf_size) {
+static bool format_quiz_scores(const ServerState* state, ByteBuffer* out, bool is_sport_quiz) {
     const char* quiz_name = is_sport_quiz ? "Sport" : "Geografia";
-    *offset += snprintf(buffer + *offset, buf_size - *offset, "\nPunteggio %s:\n", quiz_name);
+    if (!append_format(out, "\nPunteggio %s:\n", quiz_name)) return false;
 
-    // Ordina i giocatori in ordine decrescente di punteggio
-    sort_players_by_score(state->players, is_sport_quiz);
+    const Leaderboard* board = &state->players->leaderboards[is_sport_quiz ? 0 : 1];
     bool has_scores = false;
 
-    for (int i = 0; i < state->players->count; i++) {
-        Player* p = &state->players->players[i];
-        int score = is_sport_quiz ? p->sport_score : p->geography_score;
-        
-        if (score >= 0) {
-            *offset += snprintf(buffer + *offset, buf_size - *offset, 
-                                "- %s: %d\n", p->nickname, score);
-            has_scores = true;
-        }
+    for (const LeaderboardNode* node = leaderboard_at(board, 0); node; node = leaderboard_next(board, node)) {
+        if (!append_format(out, "- %s: %d\n", node->nickname, node->score)) return false;
+        has_scores = true;
     }
 
     if (!has_scores) {
-        *offset += snprintf(buffer + *offset, buf_size - *offset, 
-                         "Nessun giocatore ha ancora partecipato\n");
+        return append_format(out, "Nessun giocatore ha ancora partecipato\n");
     }
+    return true;
 }
 
 /**
- * Formatta la sezione dei quiz completati in una stringa
+ * Formatta la sezione dei quiz completati
  * @param state puntatore allo stato del server
- * @param buffer buffer di output
- * @param offset offset attuale del buffer
+ * @param out ByteBuffer* in cui aggiungere il testo
  * @param is_sport_quiz true se si vuole formattare la sezione per il quiz Sport, false per Geografia
+ * @return true se il testo è stato aggiunto, false se l'allocazione fallisce
  * @note Aggiunge i nomi dei giocatori che hanno completato il quiz al buffer.
  * @note Se nessun giocatore ha completato il quiz, aggiunge una semplice nota.
  */
-static void format_completed_quiz_section(const ServerState* state, char* buffer, 
-                                            int* offset, bool is_sport_quiz, size_t buf_size) {
-
+static bool format_completed_quiz_section(const ServerState* state, ByteBuffer* out, bool is_sport_quiz) {
     const char* quiz_name = is_sport_quiz ? "Sport" : "Geografia";
-    *offset += snprintf(buffer + *offset, buf_size - *offset, 
-                      "\nQuiz %s completato da:\n", quiz_name);
+    if (!append_format(out, "\nQuiz %s completato da:\n", quiz_name)) return false;
 
     bool has_completed = false;
 
     for (int i = 0; i < state->players->count; i++) {
-        Player* p = &state->players->players[i];
+        Player* p = player_at(state->players, i);
         if ((is_sport_quiz && p->completed_sport) || 
             (!is_sport_quiz && p->completed_geography)) {
-            *offset += snprintf(buffer + *offset, buf_size - *offset, 
-                             "- %s\n", p->nickname);
+            if (!append_format(out, "- %s\n", p->nickname)) return false;
             has_completed = true;
         }
     }
 
     if (!has_completed) {
-        *offset += snprintf(buffer + *offset, buf_size - *offset, 
-                         "Nessun giocatore ha completato questo quiz\n");
+        return append_format(out, "Nessun giocatore ha completato questo quiz\n");
+    }
+    return true;
+}
+
+bool format_scores(ServerState* state, ByteBuffer* out) {
+    // Il testo viene scritto direttamente nel buffer del chiamante, che
+    // riusandolo tra una richiesta e l'altra non alloca memoria
+    return format_participants_section(state, out) &&
+           format_quiz_scores(state, out, true) &&                // Punteggi quiz Sport
+           format_quiz_scores(state, out, false) &&               // Punteggi quiz Geografia
+           format_completed_quiz_section(state, out, true) &&     // Quiz Sport completati
+           format_completed_quiz_section(state, out, false);      // Quiz Geografia completati
+}
+
+bool encode_score_page(ServerState* state, PlayerHandle player, uint8_t quiz,
+                       uint32_t offset, uint32_t limit, uint8_t flags, ByteBuffer* out) {
+    if (quiz != 1 && quiz != 2) return false;
+
+    const Leaderboard* board = &state->players->leaderboards[quiz - 1];
+    if (limit > SCORE_PAGE_MAX_ENTRIES) limit = SCORE_PAGE_MAX_ENTRIES;
+    if (offset > (uint32_t)board->count) offset = board->count;
+    if (limit > board->count - offset) limit = board->count - offset;
+
+    flags &= SCORE_QUERY_MY_RANK;
+    if (!append_u8(out, quiz) ||
+        !append_u8(out, flags) ||
+        !append_varint(out, board->count) ||
+        !append_varint(out, offset) ||
+        !append_varint(out, limit)) {
+        return false;
+    }
+
+    const LeaderboardNode* node = leaderboard_at(board, offset);
+    for (uint32_t i = 0; i < limit && node; i++, node = leaderboard_next(board, node)) {
+        if (!append_string(out, node->nickname, strlen(node->nickname)) ||
+            !append_varint(out, node->score)) {
+            return false;
+        }
+    }
+
+    if (flags & SCORE_QUERY_MY_RANK) {
+        Player* requester = lookup_player(state->players, player);
+        const LeaderboardNode* mine = requester ? &requester->rankings[quiz - 1] : NULL;
+        return append_varint(out, mine ? leaderboard_rank(board, mine->score) + 1 : 0) &&
+               append_varint(out, mine ? mine->score : 0);
+    }
+    return true;
+}
+
+/**
+ * Codifica una voce vicina al richiedente in MSG_RANK
+ * @param board classifica che contiene la voce
+ * @param node voce da codificare
+ * @param out ByteBuffer* in cui aggiungere la voce
+ * @return true se la voce è stata aggiunta, false se l'allocazione fallisce
+ */
+static bool append_rank_entry(const Leaderboard* board, const LeaderboardNode* node, ByteBuffer* out) {
+    return append_varint(out, leaderboard_rank(board, node->score) + 1) &&
+           append_string(out, node->nickname, strlen(node->nickname)) &&
+           append_varint(out, node->score);
+}
+
+bool encode_player_rank(ServerState* state, PlayerHandle player, uint8_t quiz, ByteBuffer* out) {
+    if (quiz != 1 && quiz != 2) return false;
+
+    const Leaderboard* board = &state->players->leaderboards[quiz - 1];
+    Player* requester = lookup_player(state->players, player);
+    const LeaderboardNode* mine = requester ? &requester->rankings[quiz - 1] : NULL;
+
+    if (!append_u8(out, quiz) ||
+        !append_varint(out, board->count) ||
+        !append_varint(out, mine ? leaderboard_rank(board, mine->score) + 1 : 0) ||
+        !append_varint(out, mine ? mine->score : 0)) {
+        return false;
+    }
+
+    // Le voci precedenti si raccolgono risalendo e si inviano in ordine di classifica
+    const LeaderboardNode* above[RANK_NEIGHBOURS];
+    int above_count = 0;
+    for (const LeaderboardNode* node = mine ? leaderboard_prev(board, mine) : NULL;
+         node && above_count < RANK_NEIGHBOURS; node = leaderboard_prev(board, node)) {
+        above[above_count++] = node;
+    }
+
+    if (!append_varint(out, above_count)) return false;
+    for (int i = above_count - 1; i >= 0; i--) {
+        if (!append_rank_entry(board, above[i], out)) return false;
+    }
+
+    const LeaderboardNode* below[RANK_NEIGHBOURS];
+    int below_count = 0;
+    for (const LeaderboardNode* node = mine ? leaderboard_next(board, mine) : NULL;
+         node && below_count < RANK_NEIGHBOURS; node = leaderboard_next(board, node)) {
+        below[below_count++] = node;
+    }
+
+    if (!append_varint(out, below_count)) return false;
+    for (int i = 0; i < below_count; i++) {
+        if (!append_rank_entry(board, below[i], out)) return false;
+    }
+    return true;
+}
+
+/**
+ * Codifica la voce di un giocatore nella classifica v2
+ * @param p giocatore
+ * @param out ByteBuffer* in cui aggiungere la voce
+ * @return true se la voce è stata aggiunta, false se l'allocazione fallisce
+ */
+static bool append_score_entry(const Player* p, ByteBuffer* out) {
+    uint8_t flags = (p->completed_sport ? SCORE_FLAG_COMPLETED_SPORT : 0) |
+                    (p->completed_geography ? SCORE_FLAG_COMPLETED_GEOGRAPHY : 0);
+
+    return append_string(out, p->nickname, strlen(p->nickname)) &&
+           append_varint(out, p->sport_score) &&
+           append_varint(out, p->geography_score) &&
+           append_u8(out, flags);
+}
+
+bool encode_scores(ServerState* state, ByteBuffer* out) {
+    const PlayerArray* players = state->players;
+
+    if (!append_varint(out, players->version) ||
+        !append_u8(out, SCOREBOARD_FULL) ||
+        !append_varint(out, players->count)) {
+        return false;
+    }
+
+    for (int i = 0; i < players->count; i++) {
+        if (!append_score_entry(player_at(players, i), out)) return false;
+    }
+    return true;
+}
+
+bool encode_score_delta(ServerState* state, uint32_t since, size_t max_length, ByteBuffer* out) {
+    const PlayerArray* players = state->players;
+
+    // Versione sconosciuta (client nuovo o di un'altra istanza del server)
+    // o precedente ad una rimozione: la differenza non basta
+    if (since == 0 || since > players->version || since < players->reset_version) return false;
+
+    // Le voci cambiate sono in fondo all'elenco ordinato per versione: si risale
+    // fino alla prima non cambiata, quindi un client aggiornato costa O(1)
+    int changed = 0;
+    const Player* first_changed = NULL;
+    for (const Player* p = players->newest_change; p && p->version > since; p = p->older_change) {
+        first_changed = p;
+        changed++;
+
+        // Oltre metà delle voci la classifica completa costa poco di più, e oltre
+        // il limite va inviata a pezzi: in entrambi i casi si usa quella in cache
+        if (changed * 2 > players->count ||
+            SCORE_HEADER_MAX_SIZE + (size_t)changed * SCORE_ENTRY_MAX_SIZE > max_length) {
+            return false;
+        }
+    }
+
+    if (!append_varint(out, players->version) ||
+        !append_u8(out, 0) ||
+        !append_varint(out, changed)) {
+        return false;
     }
+
+    for (const Player* p = first_changed; p; p = p->newer_change) {
+        if (!append_score_entry(p, out)) return false;
+    }
+    return true;
 }
 
-char* format_scores(ServerState* state) {
-    // Stimo la dimensione in base al numero di giocatori
+/**
+ * Rilascia un riferimento ad una classifica, liberandola se era l'ultimo
+ * @param board classifica da rilasciare
+ * @note Va chiamata con scoreboard_cache_lock acquisito
+ */
+static void drop_scoreboard(RenderedScoreboard* board) {
+    if (--board->refs > 0) return;
+
+    release_buffer(&board->data);
+    free(board);
+}
 
-    int n = state->players->count;
-    size_t buf_size = 1024 + (n * 256);
+/**
+ * Produce la classifica completa nel formato richiesto
+ * @param state struttura ServerState contenente i giocatori
+ * @param format formato della classifica
+ * @return RenderedScoreboard* con un riferimento, NULL se l'allocazione fallisce
+ * @note Va chiamata con il lock dei giocatori acquisito in lettura
+ */
+static RenderedScoreboard* render_scoreboard(ServerState* state, ScoreboardFormat format) {
+    RenderedScoreboard* board = calloc(1, sizeof(RenderedScoreboard));
+    if (!board) return NULL;
 
-    char* score_buffer = malloc(buf_size);
-    if (!score_buffer) {
+    board->refs = 1;
+    board->players = state->players;
+    board->version = state->players->version;
+
+    bool built = format == SCOREBOARD_TEXT ? format_scores(state, &board->data)
+                                           : encode_scores(state, &board->data);
+    if (!built) {
+        release_buffer(&board->data);
+        free(board);
         return NULL;
     }
-    score_buffer[0] = '\0'; // Inizializzo come stringa vuota
-    int offset = 0;
-    
-    format_participants_section(state, score_buffer, &offset, buf_size);
-    format_quiz_scores(state, score_buffer, &offset, true, buf_size);   // Punteggi quiz Sport
-    format_quiz_scores(state, score_buffer, &offset, false, buf_size);  // Punteggi quiz Geografia  
-    format_completed_quiz_section(state, score_buffer, &offset, true, buf_size);   // Quiz Sport completati
-    format_completed_quiz_section(state, score_buffer, &offset, false, buf_size);  // Quiz Geografia completati
+    return board;
+}
 
-    // Ottimizzo la dimensione del buffer, allocando solo la memoria necessaria
-    char* final_buffer = realloc(score_buffer, offset + 1);
-    if (final_buffer) {
-        score_buffer = final_buffer;
+/**
+ * Prende un riferimento alla classifica in cache se corrisponde alla versione attuale
+ * @param state struttura ServerState contenente i giocatori
+ * @param format formato della classifica
+ * @return RenderedScoreboard* con un riferimento in più, NULL se manca o è superata
+ * @note Va chiamata con il lock dei giocatori acquisito in lettura, così la
+ * versione non cambia durante il confronto
+ */
+static RenderedScoreboard* take_cached_scoreboard(ServerState* state, ScoreboardFormat format) {
+    pthread_mutex_lock(&scoreboard_cache_lock);
+    RenderedScoreboard* board = scoreboard_cache[format];
+    if (board && board->players == state->players && board->version == state->players->version) {
+        board->refs++;
+    } else {
+        board = NULL;
     }
-    
-    return score_buffer;
-}
\ No newline at end of file
+    pthread_mutex_unlock(&scoreboard_cache_lock);
+    return board;
+}
+
+const RenderedScoreboard* acquire_scoreboard(ServerState* state, ScoreboardFormat format) {
+    lock_players_read(state->players);
+    RenderedScoreboard* board = take_cached_scoreboard(state, format);
+    unlock_players(state->players);
+    if (board) return board;
+
+    // Classifica superata: una sola produzione per formato alla volta. Chi
+    // attendeva ricontrolla la cache, che nel frattempo può essere aggiornata
+    pthread_mutex_lock(&scoreboard_render_locks[format]);
+    lock_players_read(state->players);
+
+    board = take_cached_scoreboard(state, format);
+    if (!board) {
+        // La produzione avviene fuori da scoreboard_cache_lock: le altre
+        // richieste continuano a prendere e rilasciare classifiche
+        board = render_scoreboard(state, format);
+        if (board) {
+            pthread_mutex_lock(&scoreboard_cache_lock);
+            if (scoreboard_cache[format]) drop_scoreboard(scoreboard_cache[format]);
+            scoreboard_cache[format] = board;
+            board->refs++;
+            pthread_mutex_unlock(&scoreboard_cache_lock);
+        }
+    }
+
+    unlock_players(state->players);
+    pthread_mutex_unlock(&scoreboard_render_locks[format]);
+    return board;
+}
+
+void release_scoreboard(const RenderedScoreboard* board) {
+    if (!board) return;
+
+    pthread_mutex_lock(&scoreboard_cache_lock);
+    drop_scoreboard((RenderedScoreboard*)board);
+    pthread_mutex_unlock(&scoreboard_cache_lock);
+}
+
+void free_scoreboard_cache() {
+    pthread_mutex_lock(&scoreboard_cache_lock);
+    for (int i = 0; i < SCOREBOARD_FORMATS; i++) {
+        if (scoreboard_cache[i]) {
+            drop_scoreboard(scoreboard_cache[i]);
+            scoreboard_cache[i] = NULL;
+        }
+    }
+    pthread_mutex_unlock(&scoreboard_cache_lock);
+}
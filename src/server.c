@@ -3,11 +3,23 @@
  * Implementazione lato server del gioco 'Trivia Quiz Multiplayer'
  * 
  * Questo file implementa un server concorrente che gestisce più client
- * simultaneamente usando select() per il multiplexing I/O. Il server gestisce
+ * simultaneamente usando epoll per il multiplexing I/O. Il server gestisce
  * più partite di quiz, tiene traccia dei punteggi dei giocatori, gestisce
  * le connessioni e disconnessioni dei client in modo corretto.
+ *
+ * Con l'opzione --workers N il server avvia N thread worker, ognuno con il
+ * proprio socket di ascolto (SO_REUSEPORT), il proprio ciclo di eventi e la
+ * propria tabella dei client. L'array dei giocatori è condiviso tra i worker
+ * e protetto dal suo lock lettori/scrittori.
+ *
+ * Con l'opzione --engine uring i worker usano io_uring al posto di epoll:
+ * accept multishot, recv multishot con buffer forniti dal kernel e un solo
+ * invio per connessione con tutti i messaggi accodati nell'iterazione.
  */
 
+// Necessario per accept4()
+#define _GNU_SOURCE
+
 #include "include/server.h"
 #include "include/quiz.h"
 #include "include/score.h"
@@ -18,36 +30,72 @@
 #include <unistd.h>
 #include <stdbool.h>
 #include <signal.h>
+#include <pthread.h>
+#include <errno.h>
+#include <sys/resource.h>
+#include <sys/eventfd.h>
 
 /* Variabili globali del server */
-static ClientData client_data[FD_SETSIZE];
+// I quiz sono caricati all'avvio e poi solo letti, quindi condivisi senza lock
 static Quiz* sport_quiz = NULL;
 static Quiz* geography_quiz = NULL;
-static ServerState* server_state = NULL;
+
+// Frame dei messaggi di stato, indicizzati per [client v2][codice di stato]
+static StaticFrame status_frames[2][STATUS_COUNT];
+
+// Tag nei bit bassi dello user_data degli SQE io_uring per distinguere le operazioni
+#define URING_OP_ACCEPT 0
+#define URING_OP_RECV 1
+#define URING_OP_SEND 2
+#define URING_OP_WAKEUP 3
+#define URING_OP_MASK 3
+
+// Token epoll del socket di ascolto e del wakeup_fd: gli handle dei client
+// hanno sempre una generazione nei 32 bit alti, quindi non li assumono mai
+#define EVENT_TOKEN_LISTENER 1
+#define EVENT_TOKEN_WAKEUP 2
+
+static ClientData* client_at(ServerState* state, int slot);
+static void release_uring_connection(ServerState* state, UringConnection* conn);
+static void flush_uring_sends(ServerState* state);
+static void handle_uring_send(ServerState* state, UringConnection* conn,
+                              const struct io_uring_cqe* cqe);
 
 /* Funzioni di inizializzazione e cleanup */
 
-bool init_server_socket(ServerState* state, const char* ip, int port) {
+bool init_server_socket(ServerState* state, const char* ip, const ServerConfig* config) {
     struct sockaddr_in server_addr;
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     inet_pton(AF_INET, ip, &server_addr.sin_addr);
-    server_addr.sin_port = htons(port);
+    server_addr.sin_port = htons(config->port);
+
+    // Con più worker ognuno ha il proprio socket di ascolto sulla stessa porta
+    // e il kernel distribuisce le nuove connessioni tra di essi
+    if (config->workers > 1) {
+        int opt = 1;
+        if (setsockopt(state->server_socket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+            perror("Errore nell'impostazione di SO_REUSEPORT");
+            return false;
+        }
+    }
 
     if (bind(state->server_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
         return false;
     }
 
-    if (listen(state->server_socket, 20) < 0) {
+    // Una coda corta fa scartare i SYN quando molti client si connettono insieme
+    if (listen(state->server_socket, config->backlog) < 0) {
         return false;
     }
 
-    return true;
+    return set_nonblocking(state->server_socket);
 }
 
-ServerState* init_server(const char* ip, int port) {
+ServerState* init_server(const char* ip, const ServerConfig* config, PlayerArray* players) {
     ServerState* state = malloc(sizeof(ServerState));
     if (!state) return NULL;
+    memset(state, 0, sizeof(ServerState));
 
     state->server_socket = create_socket();
     if (state->server_socket < 0) {
@@ -55,284 +103,948 @@ ServerState* init_server(const char* ip, int port) {
         return NULL;
     }
 
-    if (!init_server_socket(state, ip, port)) {
+    if (!init_server_socket(state, ip, config)) {
         close(state->server_socket);
         free(state);
         return NULL;
     }
 
-    state->players = create_player_array(INITIAL_PLAYER_ARRAY_SIZE);
-    if (!state->players) {
+    // L'array dei giocatori e la configurazione sono condivisi tra tutti i worker
+    state->players = players;
+    state->config = config;
+
+    // Descrittore usato dal thread principale per svegliare il worker allo shutdown
+    state->wakeup_fd = eventfd(0, EFD_CLOEXEC);
+    if (state->wakeup_fd < 0) {
         close(state->server_socket);
         free(state);
         return NULL;
     }
 
-    FD_ZERO(&state->active_fds);
-    FD_SET(state->server_socket, &state->active_fds);
-    state->max_fd = state->server_socket;
+    state->engine = config->engine;
+    state->free_client_slot = -1;
+    if (state->engine == ENGINE_URING) {
+        // Il socket di ascolto e il wakeup_fd vengono armati all'avvio del worker
+        state->ring = create_uring(URING_QUEUE_DEPTH, URING_BUFFER_COUNT, URING_BUFFER_SIZE);
+        if (!state->ring) {
+            close(state->wakeup_fd);
+            close(state->server_socket);
+            free(state);
+            return NULL;
+        }
+    } else {
+        state->loop = create_event_loop(EVENT_BATCH_SIZE);
+        if (!state->loop ||
+            !event_loop_add(state->loop, state->server_socket, EPOLLIN, EVENT_TOKEN_LISTENER) ||
+            !event_loop_add(state->loop, state->wakeup_fd, EPOLLIN, EVENT_TOKEN_WAKEUP)) {
+            free_event_loop(state->loop);
+            close(state->wakeup_fd);
+            close(state->server_socket);
+            free(state);
+            return NULL;
+        }
+    }
+    state->client_count = 0;
+
+    // Scadenze di login, inattività e messaggi incompleti dei client del worker
+    state->now_ms = timer_now_ms();
+    state->timers = create_timer_wheel(TIMER_TICK_MS, state->now_ms);
+    if (!state->timers) {
+        cleanup_server(state);
+        return NULL;
+    }
 
     return state;
 }
 
 void cleanup_server(ServerState* state) {
     if (state) {
-        for (int i = 0; i <= state->max_fd; i++) {
-            if (FD_ISSET(i, &state->active_fds)) {
-                close(i);
-            }
+        // Si scorrono solo i client connessi, partendo dall'ultimo perché il
+        // rilascio sposta l'ultimo elemento al posto di quello rimosso
+        while (state->client_count > 0) {
+            int client_socket = client_at(state, state->live_clients[state->client_count - 1])->fd;
+            release_client_data(state, client_socket);
+            close(client_socket);
+        }
+        close(state->server_socket);
+        close(state->wakeup_fd);
+        free_event_loop(state->loop);
+
+        // Chiudere l'istanza io_uring annulla tutte le operazioni in volo,
+        // quindi le connessioni ancora referenziate possono essere liberate
+        free_uring(state->ring);
+        while (state->uring_connections) {
+            UringConnection* conn = state->uring_connections;
+            state->uring_connections = conn->next;
+            release_buffer(&conn->pending);
+            release_buffer(&conn->inflight);
+            free(conn);
         }
-        free_player_array(state->players);
+        free(state->dirty_connections);
+        free(state->dirty_clients);
+        free(state->ready_clients);
+        release_buffer(&state->scratch);
+        free_timer_wheel(state->timers);
+        for (int i = 0; i < state->client_pages_count; i++) {
+            free(state->client_pages[i]);
+        }
+        free(state->client_pages);
+        free(state->live_clients);
+        free(state->fd_slots);
         free(state);
     }
-    if (sport_quiz) free_quiz(sport_quiz);
-    if (geography_quiz) free_quiz(geography_quiz);
+}
+
+void raise_fd_limit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &limit) < 0) {
+            perror("Impossibile alzare il limite dei file descriptor");
+        }
+    }
 }
 
 /* Funzioni di gestione connessioni */
 
-void update_max_fd(ServerState* state) {
-    while (state->max_fd > 0 && !FD_ISSET(state->max_fd, &state->active_fds)) {
-        state->max_fd--;
+/**
+ * Restituisce i dati memorizzati in uno slot del slab dei client
+ * @param state stato del worker proprietario del slab
+ * @param slot indice dello slot
+ * @return ClientData* dello slot, connesso o libero
+ */
+static ClientData* client_at(ServerState* state, int slot) {
+    return &state->client_pages[slot / CLIENT_SLAB_PAGE_SIZE][slot % CLIENT_SLAB_PAGE_SIZE];
+}
+
+/**
+ * Aggiunge una pagina al slab dei client e ne inserisce gli slot nella lista libera
+ * @param state stato del worker proprietario del slab
+ * @return true se la pagina è stata allocata, false altrimenti
+ * @note Le pagine esistenti non vengono spostate, quindi i puntatori ai
+ * ClientData (e i loro timer) restano validi mentre il slab cresce
+ */
+static bool grow_client_slab(ServerState* state) {
+    ClientData** new_pages = realloc(state->client_pages,
+                                     sizeof(ClientData*) * (state->client_pages_count + 1));
+    if (!new_pages) return false;
+    state->client_pages = new_pages;
+
+    ClientData* page = calloc(CLIENT_SLAB_PAGE_SIZE, sizeof(ClientData));
+    if (!page) return false;
+    state->client_pages[state->client_pages_count] = page;
+
+    // Gli slot vengono concatenati in ordine, così i primi assegnati sono i primi della pagina
+    int first = state->client_pages_count * CLIENT_SLAB_PAGE_SIZE;
+    for (int i = CLIENT_SLAB_PAGE_SIZE - 1; i >= 0; i--) {
+        page[i].slot = first + i;
+        page[i].generation = 1;
+        page[i].next_free = state->free_client_slot;
+        state->free_client_slot = first + i;
     }
+    state->client_pages_count++;
+    return true;
 }
 
-void init_client_data(int client_socket) {
-    memset(&client_data[client_socket], 0, sizeof(ClientData));
+/**
+ * Si assicura che la tabella da socket a slot copra il socket indicato
+ * @param state stato del worker proprietario della tabella
+ * @param client_socket socket del client
+ * @return true se la tabella copre il socket, false se la riallocazione fallisce
+ * @note La capacità viene raddoppiata fino a contenere il socket, come per PlayerArray
+ */
+static bool ensure_fd_capacity(ServerState* state, int client_socket) {
+    if (client_socket < state->fd_slots_capacity) return true;
+
+    int new_capacity = state->fd_slots_capacity > 0 ? state->fd_slots_capacity : INITIAL_CLIENT_TABLE_SIZE;
+    while (new_capacity <= client_socket) {
+        new_capacity *= 2;
+    }
+
+    int* new_slots = realloc(state->fd_slots, sizeof(int) * new_capacity);
+    if (!new_slots) return false;
+
+    // I nuovi socket non sono associati ad alcun client
+    memset(new_slots + state->fd_slots_capacity, 0,
+           sizeof(int) * (new_capacity - state->fd_slots_capacity));
+    state->fd_slots = new_slots;
+    state->fd_slots_capacity = new_capacity;
+    return true;
+}
+
+/**
+ * Assegna ad un socket uno slot libero del slab e lo aggiunge ai client connessi
+ * @param state stato del worker proprietario del slab
+ * @param client_socket socket del client
+ * @return ClientData* azzerato, con slot, generazione e socket impostati,
+ * o NULL in caso di errore di allocazione
+ */
+static ClientData* allocate_client(ServerState* state, int client_socket) {
+    if (!ensure_fd_capacity(state, client_socket)) return NULL;
+    if (state->free_client_slot < 0 && !grow_client_slab(state)) return NULL;
+
+    if (state->client_count == state->live_clients_capacity) {
+        int new_capacity = state->live_clients_capacity > 0 ?
+                           state->live_clients_capacity * 2 : INITIAL_CLIENT_TABLE_SIZE;
+        int* new_live = realloc(state->live_clients, sizeof(int) * new_capacity);
+        if (!new_live) return NULL;
+        state->live_clients = new_live;
+        state->live_clients_capacity = new_capacity;
+    }
+
+    int slot = state->free_client_slot;
+    ClientData* client = client_at(state, slot);
+    state->free_client_slot = client->next_free;
+
+    uint32_t generation = client->generation;
+    memset(client, 0, sizeof(ClientData));
+    client->slot = slot;
+    client->generation = generation;
+    client->fd = client_socket;
+
+    client->live_index = state->client_count;
+    state->live_clients[state->client_count++] = slot;
+    state->fd_slots[client_socket] = slot + 1;
+    return client;
+}
+
+ClientData* get_client(ServerState* state, int client_socket) {
+    if (client_socket < 0 || client_socket >= state->fd_slots_capacity ||
+        state->fd_slots[client_socket] == 0) {
+        return NULL;
+    }
+    return client_at(state, state->fd_slots[client_socket] - 1);
+}
+
+ClientData* lookup_client(ServerState* state, ClientHandle handle) {
+    uint32_t slot = (uint32_t)handle;
+    if (slot >= (uint32_t)(state->client_pages_count * CLIENT_SLAB_PAGE_SIZE)) return NULL;
+
+    ClientData* client = client_at(state, (int)slot);
+    if (!client->is_connected || client->generation != (uint32_t)(handle >> 32)) return NULL;
+    return client;
+}
+
+ClientHandle client_handle(const ClientData* client) {
+    return ((uint64_t)client->generation << 32) | (uint32_t)client->slot;
+}
+
+bool init_client_data(ServerState* state, int client_socket) {
+    ClientData* client = allocate_client(state, client_socket);
+    if (!client) return false;
+
+    client->is_connected = true;
+
+    // Fino alla negoziazione su MSG_LOGIN si parla il protocollo v1
+    client->protocol = PROTOCOL_VERSION_LEGACY;
     
     // All'inizio il client non è in partita
-    client_data[client_socket].is_playing = false;
+    client->is_playing = false;
+
+    client->timer.owner = client_handle(client);
+    client->connected_at = state->now_ms;
+    client->last_activity = state->now_ms;
+    schedule_client_timer(state, client_socket);
+    return true;
 }
 
-void handle_new_connection(ServerState* state) {
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
-    
-    int client_socket = accept(state->server_socket, 
-                             (struct sockaddr*)&client_addr, 
-                             &client_len);
-    
-    if (client_socket < 0) {
-        perror("Errore nell'accept");
-        return;
+void release_client_data(ServerState* state, int client_socket) {
+    ClientData* client = get_client(state, client_socket);
+    if (!client) return;
+
+    timer_wheel_cancel(state->timers, &client->timer);
+    release_buffer(&client->input);
+    release_buffer(&client->output);
+    release_scoreboard(client->stream);
+
+    // Rimozione dai client connessi: l'ultimo prende il posto di quello uscente
+    int last = state->live_clients[--state->client_count];
+    state->live_clients[client->live_index] = last;
+    client_at(state, last)->live_index = client->live_index;
+    state->fd_slots[client_socket] = 0;
+
+    // Cambiando generazione gli handle ancora in giro non raggiungono il prossimo client
+    int slot = client->slot;
+    uint32_t generation = client->generation + 1;
+    memset(client, 0, sizeof(ClientData));
+    client->slot = slot;
+    client->generation = generation != 0 ? generation : 1;
+    client->next_free = state->free_client_slot;
+    state->free_client_slot = slot;
+}
+
+/**
+ * Calcola la prossima scadenza di un client
+ * @param client dati del client
+ * @param reason se non NULL riceve la descrizione della scadenza
+ * @return istante della scadenza in millisecondi
+ */
+static uint64_t client_deadline(const ClientData* client, const char** reason) {
+    uint64_t deadline = client->last_activity + IDLE_TIMEOUT_MS;
+    const char* why = "inattività";
+
+    if (client->nickname[0] == '\0' && client->connected_at + LOGIN_TIMEOUT_MS < deadline) {
+        deadline = client->connected_at + LOGIN_TIMEOUT_MS;
+        why = "login non completato";
+    }
+    if (client->partial_since > 0 && client->partial_since + PARTIAL_FRAME_TIMEOUT_MS < deadline) {
+        deadline = client->partial_since + PARTIAL_FRAME_TIMEOUT_MS;
+        why = "messaggio incompleto";
     }
 
-    FD_SET(client_socket, &state->active_fds);
-    if (client_socket > state->max_fd) {
-        state->max_fd = client_socket;
+    if (reason) *reason = why;
+    return deadline;
+}
+
+void schedule_client_timer(ServerState* state, int client_socket) {
+    ClientData* client = get_client(state, client_socket);
+    timer_wheel_schedule(state->timers, &client->timer, client_deadline(client, NULL));
+}
+
+void handle_client_timer(Timer* timer, void* ctx) {
+    ServerState* state = (ServerState*)ctx;
+    ClientData* client = lookup_client(state, timer->owner);
+    if (!client) return;
+    int client_socket = client->fd;
+
+    const char* reason;
+    uint64_t deadline = client_deadline(client, &reason);
+    if (deadline > state->now_ms) {
+        // Il client è stato attivo dopo la programmazione del timer
+        timer_wheel_schedule(state->timers, timer, deadline);
+        return;
     }
 
-    init_client_data(client_socket);
+    DEBUG_PRINT("Client con socket %d disconnesso per %s", client_socket, reason);
+    handle_disconnect(state, client_socket);
+}
+
+void handle_new_connection(ServerState* state) {
+    // Il socket di ascolto è non bloccante: si accetta finché la coda non è vuota
+    while (true) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+
+        // Il worker non deve mai bloccarsi sulla recv di un singolo client
+        int client_socket = accept4(state->server_socket,
+                                    (struct sockaddr*)&client_addr,
+                                    &client_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_socket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("Errore nell'accept");
+            }
+            return;
+        }
+
+        // Le risposte vengono già raggruppate in flush_dirty_clients(): Nagle
+        // aggiungerebbe solo l'attesa dell'ACK ritardato
+        set_nodelay(client_socket);
+        if (!init_client_data(state, client_socket) ||
+            !event_loop_add(state->loop, client_socket, EPOLLIN,
+                            client_handle(get_client(state, client_socket)))) {
+            fprintf(stderr, "Impossibile registrare il client con socket %d\n", client_socket);
+            release_client_data(state, client_socket);
+            close(client_socket);
+            continue;
+        }
+
+        print_client_address(&client_addr);
+    }
+}
 
+void print_client_address(const struct sockaddr_in* client_addr) {
     char client_ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &(client_addr.sin_addr), client_ip, INET_ADDRSTRLEN);
-    printf("\nNuovo client connesso\n");
-    printf("Indirizzo IP client: %s, Porta: %d\n", 
-           client_ip, ntohs(client_addr.sin_port));
+    inet_ntop(AF_INET, &(client_addr->sin_addr), client_ip, INET_ADDRSTRLEN);
+    DEBUG_PRINT("Nuovo client connesso - Indirizzo IP client: %s, Porta: %d",
+                client_ip, ntohs(client_addr->sin_port));
 }
 
 void handle_disconnect(ServerState* state, int client_socket) {
-    if (strlen(client_data[client_socket].nickname) > 0) {
-        // Resetta i punteggi del giocatore e lo segna come non connesso
-        reset_player_connection(state->players, client_data[client_socket].nickname);
+    ClientData* client = get_client(state, client_socket);
+    if (strlen(client->nickname) > 0) {
+        // Il quiz interrotto conta come completato, come con endquiz: altrimenti
+        // riconnettendosi lo si potrebbe rigiocare sommando altri punti
+        lock_players_write(state->players);
+        Player* player = lookup_player(state->players, client->player);
+        if (client->is_playing) {
+            mark_quiz_as_completed(state->players, player, client->current_quiz == 1);
+        }
+        reset_player_connection(player);
+        unlock_players(state->players);
         
-        // Registro la disconnessione e il reset per il debug
-        DEBUG_PRINT("Player %s disconnesso - reset del punteggio per i quiz non completati\n", 
-                   client_data[client_socket].nickname);
+        // Registro la disconnessione per il debug
+        DEBUG_PRINT("Player %s disconnesso - quiz in corso segnato come completato\n", 
+                   client->nickname);
     }
 
-    printf("\nClient disconnesso con socket %d\n", client_socket);
+    DEBUG_PRINT("Client disconnesso con socket %d", client_socket);
+
+    if (client->uring_conn) {
+        // La shutdown fa terminare la recv multishot ancora armata sul socket;
+        // la connessione viene liberata quando tutte le sue operazioni sono concluse
+        client->uring_conn->closed = true;
+        shutdown(client_socket, SHUT_RDWR);
+        release_uring_connection(state, client->uring_conn);
+    } else {
+        event_loop_remove(state->loop, client_socket);
+    }
 
     // Clear client data
-    memset(&client_data[client_socket], 0, sizeof(ClientData));
+    release_client_data(state, client_socket);
     
     // Clean up socket
-    FD_CLR(client_socket, &state->active_fds);
     close(client_socket);
+}
+
+/* Funzioni di gestione messaggi */
 
-    if (client_socket == state->max_fd) {
-        update_max_fd(state);
+/**
+ * Restituisce i byte in uscita non ancora inviati a un client
+ * @param state stato del worker
+ * @param client_socket socket del client
+ * @return byte accodati o in volo
+ */
+static size_t pending_output(ServerState* state, int client_socket) {
+    ClientData* client = get_client(state, client_socket);
+    if (state->engine == ENGINE_URING) {
+        return client->uring_conn ?
+               client->uring_conn->pending.length + client->uring_conn->inflight.length : 0;
     }
+    return client->output.length;
 }
 
-/* Funzioni di gestione messaggi */
+/**
+ * Accoda header e payload di un messaggio con il motore del worker
+ * @param state stato del worker
+ * @param client_socket socket del client
+ * @param header byte dell'header (o dell'intero frame)
+ * @param header_size numero di byte di header
+ * @param payload byte del payload, NULL se nessuno
+ * @param length numero di byte di payload
+ * @return byte accodati o ERR_SEND in caso di errore, come send_to_client()
+ */
+static ssize_t queue_output(ServerState* state, int client_socket, const char* header,
+                            size_t header_size, const char* payload, size_t length) {
+    ClientData* client = get_client(state, client_socket);
+    if (client->send_failed) return ERR_SEND;
+
+    ssize_t queued = state->engine == ENGINE_URING ?
+                     queue_uring_output(state, client_socket, header, header_size, payload, length) :
+                     queue_client_output(state, client_socket, header, header_size, payload, length);
+    size_t pending = pending_output(state, client_socket);
+
+    // Un client che non legge le risposte non deve far crescere la coda senza limiti
+    if (queued < 0 || pending > state->config->output_high_water) {
+        if (queued >= 0) {
+            DEBUG_PRINT("Client con socket %d troppo lento: %zu byte in coda", client_socket, pending);
+        }
+        client->send_failed = true;
+        return ERR_SEND;
+    }
+    return queued;
+}
+
+ssize_t send_to_client(ServerState* state, int client_socket, Message* msg) {
+    ClientData* client = get_client(state, client_socket);
+    char header[sizeof(NetworkHeader) + 2];
+    size_t header_size;
+
+    if (client->pending_result) {
+        // L'esito della risposta precedente viaggia nello stesso frame:
+        // [esito][tipo originale] precedono il payload del messaggio
+        header_size = encode_header_v2(MSG_ANSWER_NEXT, 0, msg->length + 2, header);
+        header[header_size++] = (char)client->pending_result;
+        header[header_size++] = (char)msg->type;
+        client->pending_result = 0;
+    } else {
+        header_size = encode_message_header(msg, client->protocol, header);
+    }
+
+    DEBUG_PRINT("Accodato messaggio di tipo %s, lunghezza %d per il client %d\n",
+           message_type_to_string(msg->type), msg->length, client_socket);
+
+    return queue_output(state, client_socket, header, header_size,
+                        msg->payload, msg->length > 0 ? msg->length : 0);
+}
+
+ssize_t send_frame_to_client(ServerState* state, int client_socket, const StaticFrame* frame) {
+    return queue_output(state, client_socket, frame->data, frame->length, NULL, 0);
+}
+
+bool pump_client_stream(ServerState* state, int client_socket) {
+    ClientData* client = get_client(state, client_socket);
+    const RenderedScoreboard* board = client->stream;
+
+    while (board && pending_output(state, client_socket) < SCOREBOARD_CHUNK_SIZE) {
+        size_t length = board->data.length - client->stream_offset;
+        if (length > SCOREBOARD_CHUNK_SIZE) length = SCOREBOARD_CHUNK_SIZE;
+        bool last = client->stream_offset + length == board->data.length;
+
+        // In v1 l'header con la lunghezza totale è già partito e i pezzi sono solo
+        // byte del payload; in v2 ogni pezzo è un frame, con MSG_FLAG_MORE tranne l'ultimo
+        char header[PROTOCOL_MAX_HEADER_SIZE];
+        size_t header_size = 0;
+        if (client->protocol >= PROTOCOL_VERSION) {
+            header_size = encode_header_v2((uint8_t)client->stream_type, last ? 0 : MSG_FLAG_MORE,
+                                           (uint32_t)length, header);
+        }
+        if (queue_output(state, client_socket, header, header_size,
+                         board->data.data + client->stream_offset, length) < 0) {
+            return false;
+        }
+        client->stream_offset += length;
+
+        if (last) {
+            client->stream = NULL;
+            release_scoreboard(board);
+            board = NULL;
+        }
+    }
+    return true;
+}
+
+ssize_t queue_client_output(ServerState* state, int client_socket, const char* header,
+                            size_t header_size, const char* payload, size_t length) {
+    ClientData* client = get_client(state, client_socket);
+
+    if (!append_to_buffer(&client->output, header, header_size) ||
+        (length > 0 && !append_to_buffer(&client->output, payload, length))) {
+        return ERR_SEND;
+    }
+
+    // L'invio è rimandato a fine iterazione, così le risposte prodotte per lo
+    // stesso client (es. risultato e domanda successiva) partono con una sola send
+    if (!client->output_dirty) {
+        if (state->dirty_clients_count == state->dirty_clients_capacity) {
+            int new_capacity = state->dirty_clients_capacity > 0 ?
+                               state->dirty_clients_capacity * 2 : INITIAL_CLIENT_TABLE_SIZE;
+            ClientHandle* new_dirty = realloc(state->dirty_clients, sizeof(ClientHandle) * new_capacity);
+            if (!new_dirty) return ERR_SEND;
+            state->dirty_clients = new_dirty;
+            state->dirty_clients_capacity = new_capacity;
+        }
+        state->dirty_clients[state->dirty_clients_count++] = client_handle(client);
+        client->output_dirty = true;
+    }
+    return header_size + length;
+}
+
+void flush_dirty_clients(ServerState* state) {
+    for (int i = 0; i < state->dirty_clients_count; i++) {
+        // Il client può essersi disconnesso dopo aver accodato le risposte,
+        // e il suo socket essere già stato assegnato ad una nuova connessione
+        ClientData* client = lookup_client(state, state->dirty_clients[i]);
+        if (!client || !client->output_dirty) continue;
+        int client_socket = client->fd;
+        client->output_dirty = false;
+
+        // Se il socket è già pieno si attende EPOLLOUT invece di riprovare subito
+        if (client->send_failed ||
+            (!client->waiting_writable && !flush_client_output(state, client_socket))) {
+            handle_disconnect(state, client_socket);
+            continue;
+        }
+
+        // Uscita svuotata: prosegue la classifica in corso, poi riprendono le richieste
+        // sospese da process_input_buffer(). Il nuovo output riporta il client in coda
+        // a questa stessa lista
+        if (!client->waiting_writable && client->stream && !pump_client_stream(state, client_socket)) {
+            handle_disconnect(state, client_socket);
+            continue;
+        }
+        if (!client->waiting_writable && !client->stream && client->input.length > 0) {
+            process_input_buffer(state, client_socket);
+        }
+    }
+    state->dirty_clients_count = 0;
+}
+
+bool flush_client_output(ServerState* state, int client_socket) {
+    ClientData* client = get_client(state, client_socket);
+    size_t sent_total = 0;
+
+    while (sent_total < client->output.length) {
+        ssize_t sent = send(client_socket, client->output.data + sent_total,
+                            client->output.length - sent_total, MSG_NOSIGNAL);
+        if (sent > 0) {
+            sent_total += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+
+        client->send_failed = true;
+        return false;
+    }
+    consume_buffer(&client->output, sent_total);
+
+    // Con dati ancora in coda si attende EPOLLOUT e si smette di leggere le
+    // richieste del client: è lui a rallentare finché non consuma le risposte
+    bool pending = client->output.length > 0;
+    if (pending != client->waiting_writable) {
+        if (!event_loop_modify(state->loop, client_socket, pending ? EPOLLOUT : EPOLLIN,
+                               client_handle(client))) {
+            client->send_failed = true;
+            return false;
+        }
+        client->waiting_writable = pending;
+    }
+    return true;
+}
+
+void handle_client_writable(ServerState* state, int client_socket) {
+    if (!flush_client_output(state, client_socket)) {
+        handle_disconnect(state, client_socket);
+        return;
+    }
+
+    // Uscita svuotata: prosegue la classifica in corso o si riprendono le richieste rimaste in sospeso
+    ClientData* client = get_client(state, client_socket);
+    if (!client->waiting_writable && client->stream) {
+        if (!pump_client_stream(state, client_socket)) handle_disconnect(state, client_socket);
+    } else if (!client->waiting_writable && client->input.length > 0) {
+        process_input_buffer(state, client_socket);
+    }
+}
+
+/**
+ * Restituisce il tipo del messaggio con cui viene inviato un codice di stato
+ * @param code codice di stato
+ * @return tipo del messaggio
+ */
+static MessageType status_message_type(StatusCode code) {
+    switch (code) {
+        case STATUS_NICKNAME_PROMPT: return MSG_NICKNAME_PROMPT;
+        case STATUS_LOGIN_NEW:
+        case STATUS_LOGIN_RETURNING: return MSG_LOGIN_SUCCESS;
+        case STATUS_ANSWER_WRONG:
+        case STATUS_ANSWER_CORRECT: return MSG_ANSWER_RESULT;
+        case STATUS_QUIZ_COMPLETED:
+        case STATUS_QUIZ_ENDED: return MSG_QUIZ_COMPLETED;
+        case STATUS_QUIZ_UNAVAILABLE: return MSG_QUIZ_AVAILABLE;
+        case STATUS_TRIVIA_COMPLETED: return MSG_TRIVIA_COMPLETED;
+        case STATUS_SERVER_SHUTDOWN: return MSG_DISCONNECT;
+        case STATUS_QUIZ_IN_PROGRESS:
+        case STATUS_REQUEST_FAILED: return MSG_ERROR;
+        default: return MSG_LOGIN_ERROR;
+    }
+}
+
+void build_status_frames() {
+    for (int code = 1; code < STATUS_COUNT; code++) {
+        for (int v2 = 0; v2 < 2; v2++) {
+            StaticFrame* frame = &status_frames[v2][code];
+            uint8_t status = code;
+
+            // Ai client v2 basta il codice (il prompt del nickname non ha
+            // nemmeno quello), ai client v1 si invia il testo
+            Message msg;
+            msg.type = status_message_type(code);
+            if (v2) {
+                msg.length = code == STATUS_NICKNAME_PROMPT ? 0 : 1;
+                msg.payload = (char*)&status;
+            } else {
+                msg.length = strlen(status_text(code));
+                msg.payload = (char*)status_text(code);
+            }
+
+            frame->length = encode_message_header(&msg, v2 ? PROTOCOL_VERSION : PROTOCOL_VERSION_LEGACY,
+                                                  frame->data);
+            memcpy(frame->data + frame->length, msg.payload, msg.length);
+            frame->length += msg.length;
+        }
+    }
+}
+
+/**
+ * Invia un messaggio il cui contenuto è un codice di stato
+ * @param state stato del worker
+ * @param client_socket socket del client
+ * @param code codice di stato da inviare
+ * @return byte accodati o ERR_SEND in caso di errore, come send_to_client()
+ * @note Il frame è già codificato da build_status_frames(): il codice per i
+ * client v2, il testo corrispondente per i client v1
+ */
+static ssize_t send_status(ServerState* state, int client_socket, StatusCode code) {
+    ClientData* client = get_client(state, client_socket);
+
+    // Il frame precostruito non ha spazio per l'esito di una risposta in sospeso
+    if (client->pending_result) {
+        uint8_t status = code;
+        Message msg;
+        msg.type = status_message_type(code);
+        msg.length = 1;
+        msg.payload = (char*)&status;
+        return send_to_client(state, client_socket, &msg);
+    }
+
+    bool v2 = client->protocol >= PROTOCOL_VERSION;
+    return send_frame_to_client(state, client_socket, &status_frames[v2][code]);
+}
+
+/**
+ * Inizia la costruzione del payload di una risposta
+ * @param state stato del worker
+ * @return buffer vuoto del worker in cui scrivere il payload
+ * @note Il buffer viene riusato da una risposta all'altra: a regime
+ * costruire un payload non richiede allocazioni. Il contenuto resta
+ * valido fino alla successiva begin_payload()
+ */
+static ByteBuffer* begin_payload(ServerState* state) {
+    clear_buffer(&state->scratch);
+    return &state->scratch;
+}
+
+/**
+ * Invia un payload costruito con begin_payload()
+ * @param state stato del worker
+ * @param client_socket socket del client
+ * @param type tipo del messaggio
+ * @param payload payload da inviare
+ * @param built false se la richiesta non è valida o la costruzione del payload è fallita
+ * @return byte accodati o ERR_SEND in caso di errore
+ * @note send_to_client() copia il payload nella coda del client,
+ * quindi il buffer è subito riutilizzabile
+ * @note Se il payload non è stato costruito si invia MSG_ERROR con
+ * STATUS_REQUEST_FAILED, già codificato: il client non resta senza risposta
+ */
+static ssize_t send_payload(ServerState* state, int client_socket, MessageType type,
+                            const ByteBuffer* payload, bool built) {
+    if (!built) return send_status(state, client_socket, STATUS_REQUEST_FAILED);
 
-void send_nickname_prompt(int client_socket) {
     Message msg;
-    msg.type = MSG_NICKNAME_PROMPT;
-    const char* prompt = "\nTrivia Quiz\n"
-                        "+++++++++++++++++++++++++++++++++++++++++\n"
-                        "Scegli un nickname (deve essere univoco): ";
-    msg.length = strlen(prompt);
-    msg.payload = malloc(msg.length + 1);
+    msg.type = type;
+    msg.length = payload->length;
+    msg.payload = payload->data;
+    return send_to_client(state, client_socket, &msg);
+}
 
-    if (!msg.payload) return;
-    strcpy(msg.payload, prompt);
+/**
+ * Invia la classifica completa conservata nella cache
+ * @param state stato del worker
+ * @param client_socket socket del client
+ * @param type tipo del messaggio
+ * @param format formato della classifica
+ * @param status codice di stato il cui testo precede la classifica (0 se nessuno,
+ * solo per i client v1)
+ * @return byte accodati o ERR_SEND in caso di errore
+ * @note Non va chiamata con il lock dei giocatori acquisito: la classifica
+ * viene prodotta solo se è cambiata, altrimenti viene soltanto copiata
+ * @note La classifica viene accodata a pezzi da pump_client_stream(), che tiene
+ * un riferimento alla versione in cache finché l'ultimo pezzo non è accodato
+ */
+static ssize_t send_scoreboard(ServerState* state, int client_socket, MessageType type,
+                               ScoreboardFormat format, StatusCode status) {
+    ClientData* client = get_client(state, client_socket);
+    if (client->stream) return ERR_SEND;
+
+    const RenderedScoreboard* board = acquire_scoreboard(state, format);
+    if (!board) return ERR_SEND;
+
+    // Un esito in attesa parte da solo: i pezzi della classifica non possono contenerlo
+    if (client->pending_result) {
+        StatusCode result = client->pending_result;
+        client->pending_result = 0;
+        send_status(state, client_socket, result);
+    }
+
+    // In v1 l'header con la lunghezza totale precede il testo di stato e i pezzi
+    ssize_t queued = 0;
+    if (client->protocol < PROTOCOL_VERSION) {
+        ByteBuffer* payload = begin_payload(state);
+        Message msg;
+        msg.type = type;
+        msg.length = (status ? strlen(status_text(status)) + 2 : 0) + board->data.length;
+        msg.payload = NULL;
+        char header[sizeof(NetworkHeader)];
+        size_t header_size = encode_message_header(&msg, client->protocol, header);
+
+        bool built = append_to_buffer(payload, header, header_size) &&
+                     (!status || append_format(payload, "%s\n\n", status_text(status)));
+        queued = built ? queue_output(state, client_socket, payload->data, payload->length, NULL, 0)
+                       : ERR_SEND;
+        if (queued < 0) {
+            release_scoreboard(board);
+            return ERR_SEND;
+        }
+    }
 
-    send_message(client_socket, &msg);
-    free(msg.payload);
+    client->stream = board;
+    client->stream_offset = 0;
+    client->stream_type = type;
+    return pump_client_stream(state, client_socket) ? queued + (ssize_t)client->stream_offset : ERR_SEND;
 }
 
-void send_quiz_available_message(int client_socket, const char* nickname) {
+/**
+ * Negozia la versione del protocollo richiesta dal client con MSG_LOGIN
+ * @param state stato del worker
+ * @param client_socket socket del client
+ * @param msg messaggio MSG_LOGIN ricevuto
+ * @note Un client v1 invia MSG_LOGIN senza payload e non riceve risposta.
+ * La conferma viaggia ancora in framing v1, i messaggi successivi in v2
+ */
+static void negotiate_protocol(ServerState* state, int client_socket, const Message* msg) {
+    ClientData* client = get_client(state, client_socket);
+    if (client->protocol != PROTOCOL_VERSION_LEGACY || msg->length < 1 ||
+        (uint8_t)msg->payload[0] < PROTOCOL_VERSION) {
+        return;
+    }
+
+    uint8_t version = PROTOCOL_VERSION;
+    Message reply;
+    reply.type = MSG_VERSION;
+    reply.length = 1;
+    reply.payload = (char*)&version;
+    if (send_to_client(state, client_socket, &reply) < 0) return;
+
+    client->protocol = PROTOCOL_VERSION;
+    DEBUG_PRINT("Client %d usa il protocollo v%d", client_socket, client->protocol);
+}
+
+void send_nickname_prompt(ServerState* state, int client_socket) {
+    send_status(state, client_socket, STATUS_NICKNAME_PROMPT);
+}
+
+/**
+ * Invia la lista dei quiz disponibili per un giocatore
+ * @param state stato del worker
+ * @param client_socket socket del client
+ * @param status codice di stato da mostrare prima della lista (0 se nessuno,
+ * solo per i client v2)
+ */
+static void send_quiz_list(ServerState* state, int client_socket, StatusCode status) {
+    ClientData* client = get_client(state, client_socket);
     Message msg;
     msg.type = MSG_QUIZ_AVAILABLE;
     
-    bool sport_completed = has_completed_quiz(server_state->players, nickname, true);
-    bool geo_completed = has_completed_quiz(server_state->players, nickname, false);
-    
-    // Uso un buffer temporaneo per costruire il messaggio
-    // Per soli due quiz, è sufficiente 1024 byte, per più quiz si potrebbe implementare
-    // un buffer dinamico
-    char available_temp[1024];
-    int offset = snprintf(available_temp, sizeof(available_temp),
-             "Quiz disponibili\n"
-             "++++++++++++++++++++++++++++++\n");
-             
-    if (!sport_completed) {
-        offset += snprintf(available_temp + offset, sizeof(available_temp) - offset, "1 - Sport\n");
-    }
-    
-    if (!geo_completed) {
-        offset += snprintf(available_temp + offset, sizeof(available_temp) - offset, "2 - Geografia\n");
+    lock_players_read(state->players);
+    Player* player = lookup_player(state->players, client->player);
+    bool sport_completed = has_completed_quiz(player, true);
+    bool geo_completed = has_completed_quiz(player, false);
+    unlock_players(state->players);
+
+    // Ai client v2 basta la maschera dei quiz disponibili, il testo lo compone il client
+    if (client->protocol >= PROTOCOL_VERSION) {
+        char payload[2];
+        payload[0] = (char)((sport_completed ? 0 : QUIZ_MASK_SPORT) |
+                            (geo_completed ? 0 : QUIZ_MASK_GEOGRAPHY));
+        payload[1] = (char)status;
+        msg.length = status ? 2 : 1;
+        msg.payload = payload;
+        send_to_client(state, client_socket, &msg);
+        return;
     }
     
+    ByteBuffer* payload = begin_payload(state);
+    bool built;
     if (sport_completed && geo_completed) {
-        snprintf(available_temp, sizeof(available_temp),
-                "Non ci sono più quiz disponibili.\n"
-                "Hai completato tutti i quiz!\n");
+        built = append_format(payload,
+                              "Non ci sono più quiz disponibili.\n"
+                              "Hai completato tutti i quiz!\n");
     } else {
-        snprintf(available_temp + offset, sizeof(available_temp) - offset, 
-                "++++++++++++++++++++++++++++++\n");
+        built = append_format(payload,
+                              "Quiz disponibili\n"
+                              "++++++++++++++++++++++++++++++\n") &&
+                (sport_completed || append_format(payload, "1 - Sport\n")) &&
+                (geo_completed || append_format(payload, "2 - Geografia\n")) &&
+                append_format(payload, "++++++++++++++++++++++++++++++\n");
     }
+    send_payload(state, client_socket, MSG_QUIZ_AVAILABLE, payload, built);
+}
 
-    msg.length = strlen(available_temp);
-    msg.payload = malloc(msg.length + 1);
-    if (!msg.payload) return;
-    strcpy(msg.payload, available_temp);
-    send_message(client_socket, &msg);
-    free(msg.payload);
+void send_quiz_available_message(ServerState* state, int client_socket) {
+    send_quiz_list(state, client_socket, 0);
 }
 
-void send_question_to_client(int client_socket, Quiz* quiz, int question_num) {
-    ClientData* client = &client_data[client_socket];
+void send_question_to_client(ServerState* state, int client_socket, Quiz* quiz, int question_num) {
+    ClientData* client = get_client(state, client_socket);
     int actual_question_index = client->selected_question_indices[question_num];
     Question* question = get_question_by_index(quiz, actual_question_index);
     
     if (question) {
-        Message msg;
-        msg.type = MSG_QUESTION;
-
-        char formatted_question[1024];  // Uso un buffer temporaneo per costruire il messaggio
-        snprintf(formatted_question, sizeof(formatted_question),
-                "\nQuiz %s (domanda %d)\n"
-                "++++++++++++++++++++++++++++++++++++\n"
-                "Domanda: %s",
-                quiz->topic, question_num + 1,
-                question->question);
+        // v2: [quiz u8][numero domanda u8][tema][domanda], senza formattazione
+        if (client->protocol >= PROTOCOL_VERSION) {
+            ByteBuffer* payload = begin_payload(state);
+            bool built = append_u8(payload, client->current_quiz) &&
+                         append_u8(payload, question_num + 1) &&
+                         append_string(payload, quiz->topic, strlen(quiz->topic)) &&
+                         append_string(payload, question->question, strlen(question->question));
+            send_payload(state, client_socket, MSG_QUESTION, payload, built);
+            return;
+        }
 
-        msg.length = strlen(formatted_question);
-        msg.payload = malloc(msg.length + 1);
-        if (!msg.payload) return;
-        strcpy(msg.payload, formatted_question);
-        send_message(client_socket, &msg);
-        free(msg.payload);
+        ByteBuffer* payload = begin_payload(state);
+        bool built = append_format(payload,
+                                   "\nQuiz %s (domanda %d)\n"
+                                   "++++++++++++++++++++++++++++++++++++\n"
+                                   "Domanda: %s",
+                                   quiz->topic, question_num + 1,
+                                   question->question);
+        send_payload(state, client_socket, MSG_QUESTION, payload, built);
     }
 }
 
 /* Funzioni di gestione login */
 
 bool handle_existing_player(ServerState* state, int client_socket, Player* player, const char* nickname) {
-    Message msg;
-    
     // Prima controlliamo se ha completato tutti i quiz
     if (player->completed_sport && player->completed_geography) {
-        msg.type = MSG_LOGIN_ERROR;
-        const char* text = "Hai già completato tutti i quiz disponibili! Torna presto per nuovi quiz.";
-        msg.length = strlen(text);
-        msg.payload = malloc(msg.length + 1);
-        if (!msg.payload) return false;
-        strcpy(msg.payload, text);
-        send_message(client_socket, &msg);
-        free(msg.payload);
+        send_status(state, client_socket, STATUS_LOGIN_ALL_COMPLETED);
         return false;
     }
     
     // Poi controlliamo se è già connesso
     if (player->is_connected) {
-        msg.type = MSG_LOGIN_ERROR;
-        const char* text = "Nickname già in uso da un altro giocatore";
-        msg.length = strlen(text);
-        msg.payload = malloc(msg.length + 1);
-        if (!msg.payload) return false;
-        strcpy(msg.payload, text);
-        send_message(client_socket, &msg);
-        free(msg.payload);
+        send_status(state, client_socket, STATUS_LOGIN_NICKNAME_IN_USE);
         return false;
     }
     
     // Se arriviamo qui, il giocatore può giocare
     player->is_connected = true;
-    strncpy(client_data[client_socket].nickname, nickname, MAX_NICK_LENGTH - 1);
+    ClientData* client = get_client(state, client_socket);
+    strncpy(client->nickname, nickname, MAX_NICK_LENGTH - 1);
+    client->player = player_handle(player);
     
-    msg.type = MSG_LOGIN_SUCCESS;
-    const char* text = "Bentornato! Inizia un nuovo quiz per mettere alla prova le tue conoscenze!";
-    msg.length = strlen(text);
-    msg.payload = malloc(msg.length + 1);
-    if (!msg.payload) return false;
-    strcpy(msg.payload, text);
-    send_message(client_socket, &msg);
-    free(msg.payload);
-    
-    display_server_status(state);
-    send_quiz_available_message(client_socket, nickname);
-    return true;
+    return send_status(state, client_socket, STATUS_LOGIN_RETURNING) >= 0;
 }
 
 bool handle_new_player(ServerState* state, int client_socket, const char* nickname) {
     
     // Aggiungiamo il giocatore alla lista
-    bool success = add_player(state->players, nickname);
+    Player* new_player = add_player(state->players, nickname);
 
     // Se non c'è spazio per il nuovo giocatore, inviamo un messaggio di errore
-    if (!success) {
-        Message msg;
-        msg.type = MSG_LOGIN_ERROR;
-        strcpy(msg.payload, "Il server ha raggiunto la massima capacità di giocatori, riprova più tardi.");
-        msg.length = strlen(msg.payload);
-        send_message(client_socket, &msg);
+    if (!new_player) {
+        send_status(state, client_socket, STATUS_LOGIN_SERVER_FULL);
         return false;
     }
     
-    Player* new_player = find_player(state->players, nickname);
     new_player->is_connected = true;
 
-    strncpy(client_data[client_socket].nickname, nickname, MAX_NICK_LENGTH - 1);
+    ClientData* client = get_client(state, client_socket);
+    strncpy(client->nickname, nickname, MAX_NICK_LENGTH - 1);
+    client->player = player_handle(new_player);
     
-    Message msg;
-    msg.type = MSG_LOGIN_SUCCESS;
-    const char* text = "Login avvenuto con successo!";
-    msg.length = strlen(text);
-    msg.payload = malloc(msg.length + 1);
-
-    if (!msg.payload) return false;
-
-    strcpy(msg.payload, text);
-    send_message(client_socket, &msg);
-    free(msg.payload);
-    
-    display_server_status(state);
-    send_quiz_available_message(client_socket, nickname);
-    return true;
+    return send_status(state, client_socket, STATUS_LOGIN_NEW) >= 0;
 }
 
 void handle_login_request(ServerState* state, int client_socket, Message* msg) {
-    msg->payload[msg->length] = '\0';
+    // La verifica del nickname e la sua registrazione devono essere atomiche
+    // rispetto agli altri worker, altrimenti due client potrebbero ottenere lo stesso nickname
+    lock_players_write(state->players);
     Player* existing_player = find_player(state->players, msg->payload);
 
+    bool logged_in;
     if (existing_player) {
-        handle_existing_player(state, client_socket, existing_player, msg->payload);
+        logged_in = handle_existing_player(state, client_socket, existing_player, msg->payload);
     } else {
-        handle_new_player(state, client_socket, msg->payload);
+        logged_in = handle_new_player(state, client_socket, msg->payload);
+    }
+    unlock_players(state->players);
+
+    if (logged_in) {
+        send_quiz_available_message(state, client_socket);
     }
 }
 
@@ -347,50 +1059,50 @@ Question* get_current_question(Quiz* quiz, ClientData* client) {
 }
 
 void handle_answer(ServerState* state, int client_socket, Message* msg) {
-    ClientData* client = &client_data[client_socket];
+    ClientData* client = get_client(state, client_socket);
     if (!client->is_playing) return;
     
     Quiz* quiz = (client->current_quiz == 1) ? sport_quiz : geography_quiz;
-    msg->payload[msg->length] = '\0';
     DEBUG_PRINT("Ricevuta risposta dal giocatore %s: %s", client->nickname, msg->payload);
     
     int actual_question_index = client->selected_question_indices[client->current_question];
     
-    bool correct = check_answer(quiz, actual_question_index, msg->payload);
-    Player* player = find_player(state->players, client->nickname);
-
-    Message response_msg;
-    response_msg.type = MSG_ANSWER_RESULT;
-    const char* text = correct ? "Risposta corretta!" : "Risposta errata!";
-    response_msg.length = strlen(text);
-    response_msg.payload = malloc(response_msg.length + 1);
-    if (!response_msg.payload) {
+    // Una risposta più lunga di quelle accettate è sicuramente errata, e non
+    // entrerebbe nel buffer di check_answer()
+    bool correct = msg->length < MAX_ANSWER_LENGTH &&
+                   check_answer(quiz, actual_question_index, msg->payload);
+
+    // Ai client v2 l'esito viene inviato insieme al messaggio che segue
+    StatusCode result = correct ? STATUS_ANSWER_CORRECT : STATUS_ANSWER_WRONG;
+    if (client->protocol >= PROTOCOL_VERSION) {
+        client->pending_result = result;
+    } else if (send_status(state, client_socket, result) < 0) {
         handle_disconnect(state, client_socket);
         return;
     }
-    strcpy(response_msg.payload, text);
-
-    if (send_message(client_socket, &response_msg) < 0) {
-        free(response_msg.payload);
-        handle_disconnect(state, client_socket);
-        return;
-    }
-    free(response_msg.payload);
     
+    // Il giocatore si raggiunge dall'handle della sessione, senza cercarlo per nickname
+    lock_players_write(state->players);
+    Player* player = lookup_player(state->players, client->player);
     if (player) {
-        if (client->current_quiz == 1) {
-            player->sport_score += correct ? 1 : 0;
-        } else {
-            player->geography_score += correct ? 1 : 0;
+        if (correct && !add_point(state->players, player, client->current_quiz == 1)) {
+            DEBUG_PRINT("Punto rifiutato per %s: punteggio massimo già raggiunto", client->nickname);
         }
-    }
 
-    DEBUG_PRINT("Punteggio aggiornato per il giocatore %s - Quiz: %s, Nuovo punteggio: %d", 
-            client->nickname,
-            client->current_quiz == 1 ? "Sport" : "Geografia",
-            client->current_quiz == 1 ? player->sport_score : player->geography_score);
+        DEBUG_PRINT("Punteggio aggiornato per il giocatore %s - Quiz: %s, Nuovo punteggio: %d", 
+                client->nickname,
+                client->current_quiz == 1 ? "Sport" : "Geografia",
+                client->current_quiz == 1 ? player->sport_score : player->geography_score);
+    }
+    unlock_players(state->players);
 
     handle_next_question(state, client_socket, client);
+
+    // Se nessun messaggio è partito (es. allocazione fallita) l'esito viene inviato da solo
+    if (client->is_connected && client->pending_result) {
+        client->pending_result = 0;
+        send_status(state, client_socket, result);
+    }
 }
 
 void handle_next_question(ServerState* state, int client_socket, ClientData* client) {
@@ -399,75 +1111,68 @@ void handle_next_question(ServerState* state, int client_socket, ClientData* cli
         handle_quiz_completion(state, client_socket, client);
     } else {
         Quiz* quiz = (client->current_quiz == 1) ? sport_quiz : geography_quiz;
-        send_question_to_client(client_socket, quiz, client->current_question);
+        send_question_to_client(state, client_socket, quiz, client->current_question);
     }
 }
 
 void handle_quiz_completion(ServerState* state, int client_socket, ClientData* client) {
+    bool v2 = client->protocol >= PROTOCOL_VERSION;
+
     // Marca il quiz come completato anche se interrotto con endquiz
-    mark_quiz_as_completed(state->players, client->nickname, client->current_quiz == 1);
+    lock_players_write(state->players);
+    Player* player = lookup_player(state->players, client->player);
+    mark_quiz_as_completed(state->players, player, client->current_quiz == 1);
+
+    bool sport_completed = has_completed_quiz(player, true);
+    bool geo_completed = has_completed_quiz(player, false);
+    unlock_players(state->players);
     
     client->is_playing = false;
 
-    Message complete_msg;
-    complete_msg.type = MSG_QUIZ_COMPLETED;
-
-    bool sport_completed = has_completed_quiz(state->players, client->nickname, true);
-    bool geo_completed = has_completed_quiz(state->players, client->nickname, false);
-    
-    char *msg_text = NULL;
-    if (sport_completed && geo_completed) {
-        char* scores = format_scores(state);  // Now returns a dynamically allocated string
-        int len = snprintf(NULL, 0, "Hai completato tutti i quiz disponibili!\n\n%s", scores);
-        msg_text = malloc(len + 1);
-        if (!msg_text) {
-            free(scores);
-            return;
-        }
-        snprintf(msg_text, len + 1, "Hai completato tutti i quiz disponibili!\n\n%s", scores);
-        free(scores);
-        complete_msg.type = MSG_TRIVIA_COMPLETED;
-    } else {
-        const char *temp = "Quiz completato!";
-        msg_text = malloc(strlen(temp) + 1);
-        if (!msg_text) return;
-        strcpy(msg_text, temp);
-    }
-    
-    complete_msg.length = strlen(msg_text);
-    complete_msg.payload = malloc(complete_msg.length + 1);
-    if (!complete_msg.payload) {
-        free(msg_text);
+    if (!(sport_completed && geo_completed)) {
+        send_status(state, client_socket, STATUS_QUIZ_COMPLETED);
+        send_quiz_available_message(state, client_socket);
         return;
     }
-    strcpy(complete_msg.payload, msg_text);
-    free(msg_text);
-    send_message(client_socket, &complete_msg);
-    free(complete_msg.payload);
 
-    if (!(sport_completed && geo_completed)) {
-        send_quiz_available_message(client_socket, client->nickname);
+    // Classifica finale: testo per i client v1, payload strutturato per i client v2
+    if (v2) {
+        send_scoreboard(state, client_socket, MSG_TRIVIA_COMPLETED, SCOREBOARD_V2, 0);
+    } else {
+        send_scoreboard(state, client_socket, MSG_TRIVIA_COMPLETED, SCOREBOARD_TEXT, STATUS_TRIVIA_COMPLETED);
     }
 }
 
 void handle_quiz_selection(ServerState* state, int client_socket, Message* msg) {
-    ClientData* client = &client_data[client_socket];
-    bool sport_completed = has_completed_quiz(state->players, client->nickname, true);
-    bool geo_completed = has_completed_quiz(state->players, client->nickname, false);
+    ClientData* client = get_client(state, client_socket);
+
+    // Un quiz in corso non può essere ricominciato: le domande ripartirebbero
+    // da capo sommando altri punti a quelli già ottenuti. La richiesta riceve
+    // comunque una risposta, altrimenti il client resterebbe in attesa
+    if (client->is_playing) {
+        send_status(state, client_socket, STATUS_QUIZ_IN_PROGRESS);
+        return;
+    }
+
+    lock_players_read(state->players);
+    Player* player = lookup_player(state->players, client->player);
+    bool sport_completed = has_completed_quiz(player, true);
+    bool geo_completed = has_completed_quiz(player, false);
+    unlock_players(state->players);
     
-    int selected_quiz = msg->payload[0] - '0';
+    // v2 invia il numero del quiz come byte, v1 come carattere
+    int selected_quiz = client->protocol >= PROTOCOL_VERSION ?
+                        (uint8_t)msg->payload[0] : msg->payload[0] - '0';
     
     if ((selected_quiz == 1 && sport_completed) || 
         (selected_quiz == 2 && geo_completed)) {
-        msg->type = MSG_QUIZ_AVAILABLE;
-        const char* error_text = "Quiz non disponibile. Seleziona un quiz dalla lista.\n";
-        msg->length = strlen(error_text);
-        msg->payload = malloc(msg->length + 1);
-        if (!msg->payload) return;
-        strcpy(msg->payload, error_text);
-        send_message(client_socket, msg);
-        free(msg->payload);
-        send_quiz_available_message(client_socket, client->nickname);
+        if (client->protocol >= PROTOCOL_VERSION) {
+            send_quiz_list(state, client_socket, STATUS_QUIZ_UNAVAILABLE);
+            return;
+        }
+
+        send_status(state, client_socket, STATUS_QUIZ_UNAVAILABLE);
+        send_quiz_available_message(state, client_socket);
         return;
     }
     
@@ -482,7 +1187,7 @@ void handle_quiz_selection(ServerState* state, int client_socket, Message* msg)
     
     Question* first_question = get_current_question(selected_quiz_ptr, client);
     if (first_question) {
-        send_question_to_client(client_socket, selected_quiz_ptr, 
+        send_question_to_client(state, client_socket, selected_quiz_ptr, 
                               client->current_question);
     }
 }
@@ -490,28 +1195,68 @@ void handle_quiz_selection(ServerState* state, int client_socket, Message* msg)
 /* Funzioni di gestione server */
 
 void broadcast_message(ServerState* state, Message* msg) {
-    for (int i = 0; i <= state->max_fd; i++) {
-        if (FD_ISSET(i, &state->active_fds) && i != state->server_socket) {
-            send_message(i, msg);
-        }
+    // Il costo dipende dai soli client connessi, non dal socket più alto
+    for (int i = 0; i < state->client_count; i++) {
+        ClientData* client = client_at(state, state->live_clients[i]);
+        int client_socket = client->fd;
+
+        // Un messaggio in mezzo ad una classifica a pezzi ne corromperebbe il payload:
+        // quei client ricevono solo la chiusura del socket
+        if (client->stream) continue;
+
+        // Il messaggio passa dalla coda del motore: con io_uring non può
+        // inserirsi in mezzo ad un frame ancora in volo
+        send_to_client(state, client_socket, msg);
     }
 }
 
-void handle_shutdown() {
-    if (server_state) {
-        Message msg;
-        msg.type = MSG_DISCONNECT;
-        const char* text = "Server shutdown";
-        msg.length = strlen(text);
-        msg.payload = malloc(msg.length + 1);
-        if (msg.payload) {
-            strcpy(msg.payload, text);
-            broadcast_message(server_state, &msg);
-            free(msg.payload);
+/**
+ * Invia i messaggi accodati con io_uring dopo la fine del ciclo principale
+ * @param state stato del worker
+ * @note Si elaborano solo i completamenti delle send, per al più
+ * SHUTDOWN_DRAIN_MS: un client che non legge non blocca la chiusura. Le
+ * operazioni rimaste in volo vengono annullate da cleanup_server()
+ */
+static void drain_uring_sends(ServerState* state) {
+    uint64_t deadline = timer_now_ms() + SHUTDOWN_DRAIN_MS;
+
+    while (true) {
+        flush_uring_sends(state);
+
+        bool pending = false;
+        for (UringConnection* conn = state->uring_connections; conn && !pending; conn = conn->next) {
+            pending = !conn->closed && (conn->pending.length > 0 || conn->inflight.length > 0);
         }
-        cleanup_server(server_state);
+        uint64_t now = timer_now_ms();
+        if (!pending || now >= deadline) return;
+
+        if (uring_submit(state->ring, 1, (int)(deadline - now)) < 0) return;
+
+        struct io_uring_cqe* next;
+        while ((next = uring_peek_cqe(state->ring)) != NULL) {
+            struct io_uring_cqe cqe = *next;
+            uring_cqe_seen(state->ring);
+
+            if ((cqe.user_data & URING_OP_MASK) == URING_OP_SEND) {
+                UringConnection* conn = (UringConnection*)(uintptr_t)(cqe.user_data & ~(uint64_t)URING_OP_MASK);
+                handle_uring_send(state, conn, &cqe);
+            }
+        }
+    }
+}
+
+void handle_shutdown(ServerState* state) {
+    Message msg;
+    msg.type = MSG_DISCONNECT;
+    const char* text = status_text(STATUS_SERVER_SHUTDOWN);
+    msg.length = strlen(text);
+    msg.payload = (char*)text;  // Il payload viene copiato nella coda di ogni client
+    broadcast_message(state, &msg);
+    if (state->engine == ENGINE_EPOLL) {
+        flush_dirty_clients(state);
+    } else {
+        drain_uring_sends(state);
     }
-    exit(0);
 }
 
 void display_server_status(ServerState* state) {
@@ -527,27 +1272,166 @@ void display_server_status(ServerState* state) {
         printf("2. %s\n", geography_quiz->topic);
     }
     
-    char* scores = format_scores(state);
-    printf("%s", scores);
+    const RenderedScoreboard* scores = acquire_scoreboard(state, SCOREBOARD_TEXT);
+    if (scores) {
+        printf("%.*s", (int)scores->data.length, scores->data.data);
+        release_scoreboard(scores);
+    }
     printf("++++++++++++++++++++++++++++\n\n");
+    fflush(stdout);
 }
 
 /* Funzioni di gestione messaggi del client */
 
 void process_client_message(ServerState* state, int client_socket) {
-    Message msg;
-    DEBUG_PRINT("Tentativo di ricezione messaggio dal client %d\n", client_socket);
-    
-    ssize_t received = receive_message(client_socket, &msg);
-    if (received <= 0) {
+    ClientData* client = get_client(state, client_socket);
+    char buffer[BUFFER_SIZE];
+    DEBUG_PRINT("Tentativo di ricezione dati dal client %d\n", client_socket);
+
+    // Si svuota il socket: con il socket non bloccante la recv termina con EAGAIN.
+    // Oltre il limite i byte restano nel kernel e epoll segnalerà di nuovo il socket
+    while (client->input.length < INPUT_HIGH_WATER_MARK) {
+        ssize_t received = recv(client_socket, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            client->last_activity = state->now_ms;
+            if (!append_to_buffer(&client->input, buffer, received)) {
+                handle_disconnect(state, client_socket);
+                return;
+            }
+            continue;
+        }
+        if (received < 0 && errno == EINTR) continue;
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+
+        // Connessione chiusa dal client o errore
         DEBUG_PRINT("Ricezione fallita con codice %zd\n", received);
         handle_disconnect(state, client_socket);
         return;
     }
-    
+
+    process_input_buffer(state, client_socket);
+}
+
+/**
+ * Inserisce un client nella lista dei client con messaggi ancora da elaborare
+ * @param state stato del worker
+ * @param client client che ha esaurito il budget di messaggi
+ * @return true se il client è in lista, false se l'allocazione fallisce
+ */
+static bool mark_client_ready(ServerState* state, ClientData* client) {
+    if (client->input_ready) return true;
+
+    if (state->ready_clients_count == state->ready_clients_capacity) {
+        int new_capacity = state->ready_clients_capacity > 0 ?
+                           state->ready_clients_capacity * 2 : INITIAL_CLIENT_TABLE_SIZE;
+        ClientHandle* new_ready = realloc(state->ready_clients, sizeof(ClientHandle) * new_capacity);
+        if (!new_ready) return false;
+        state->ready_clients = new_ready;
+        state->ready_clients_capacity = new_capacity;
+    }
+    state->ready_clients[state->ready_clients_count++] = client_handle(client);
+    client->input_ready = true;
+    return true;
+}
+
+void process_input_buffer(ServerState* state, int client_socket) {
+    ClientData* client = get_client(state, client_socket);
+    size_t offset = 0;
+    bool incomplete = false;
+    int budget = MAX_FRAMES_PER_EVENT;
+
+    // Un byte libero oltre la fine dei dati permette di terminare in place
+    // anche il payload dell'ultimo messaggio del buffer
+    if (!reserve_buffer(&client->input, 1)) {
+        handle_disconnect(state, client_socket);
+        return;
+    }
+
+    // Un client già in lista viene ripreso da process_ready_clients(): nuovi byte
+    // o un'uscita svuotata non gli concedono un altro blocco nella stessa iterazione
+    if (client->input_ready) return;
+
+    while (offset < client->input.length) {
+        // Con troppe risposte ancora da inviare, o una classifica accodata solo in parte,
+        // le richieste restano nel buffer: vengono riprese quando l'uscita del client si svuota
+        if (client->stream ||
+            pending_output(state, client_socket) >= state->config->output_high_water / 2) break;
+
+        // Budget esaurito: i messaggi rimasti (anche già completi) aspettano che
+        // gli altri client pronti siano stati serviti
+        if (budget-- == 0) {
+            if (!mark_client_ready(state, client)) {
+                handle_disconnect(state, client_socket);
+                return;
+            }
+            break;
+        }
+
+        Message msg;
+        ssize_t consumed = parse_message(client->input.data + offset,
+                                         client->input.length - offset, &msg, client->protocol);
+        if (consumed == 0) {
+            incomplete = true;  // Messaggio incompleto, si attendono altri byte
+            break;
+        }
+        if (consumed < 0) {
+            DEBUG_PRINT("Messaggio non valido dal client %d\n", client_socket);
+            handle_disconnect(state, client_socket);
+            return;
+        }
+        offset += consumed;
+
+        // Il payload viene letto direttamente dal buffer di input: durante il
+        // dispatch il byte che lo segue (header del messaggio successivo o spazio
+        // libero) viene sostituito da '\0' e ripristinato subito dopo
+        char* payload_end = msg.payload + msg.length;
+        char saved = *payload_end;
+        *payload_end = '\0';
+        dispatch_client_message(state, client_socket, &msg);
+
+        // Il gestore può aver chiuso la connessione (e liberato il buffer)
+        if (!client->is_connected) return;
+        *payload_end = saved;
+        if (client->send_failed) {
+            handle_disconnect(state, client_socket);
+            return;
+        }
+    }
+
+    consume_buffer(&client->input, offset);
+
+    // Un messaggio rimasto a metà deve essere completato entro PARTIAL_FRAME_TIMEOUT_MS:
+    // il timer viene anticipato solo quando il messaggio incompleto compare
+    if (!incomplete) {
+        client->partial_since = 0;
+    } else if (client->partial_since == 0 || offset > 0) {
+        client->partial_since = state->now_ms;
+        schedule_client_timer(state, client_socket);
+    }
+}
+
+void process_ready_clients(ServerState* state) {
+    // I client che esauriscono di nuovo il budget vengono reinseriti dall'inizio
+    // della lista: non superano mai la posizione in lettura
+    int count = state->ready_clients_count;
+    state->ready_clients_count = 0;
+
+    for (int i = 0; i < count; i++) {
+        ClientData* client = lookup_client(state, state->ready_clients[i]);
+        if (!client || !client->input_ready) continue;
+        client->input_ready = false;
+        process_input_buffer(state, client->fd);
+    }
+}
+
+void dispatch_client_message(ServerState* state, int client_socket, Message* message) {
+    // Copia locale: i casi sottostanti riusano msg per costruire le risposte
+    Message msg = *message;
+
     switch (msg.type) {
         case MSG_LOGIN:
-            send_nickname_prompt(client_socket);
+            negotiate_protocol(state, client_socket, &msg);
+            send_nickname_prompt(state, client_socket);
             break;
 
         case MSG_REQUEST_NICKNAME:
@@ -564,47 +1448,87 @@ void process_client_message(ServerState* state, int client_socket) {
 
         case MSG_REQUEST_SCORE:
             {
-                char* scores = format_scores(state);
-                msg.type = MSG_SCORE;
-                msg.length = strlen(scores);
-                msg.payload = malloc(msg.length + 1);
-                if (!msg.payload) {
-                    free(scores);
+                // Il client v2 indica l'ultima versione della classifica che conosce
+                // e, facoltativamente, la pagina della classifica di un quiz.
+                // Le classifiche sono già ordinate: basta il lock in lettura
+                ClientData* client = get_client(state, client_socket);
+                PayloadReader reader;
+                init_payload_reader(&reader, msg.payload, msg.length);
+                uint32_t since = 0;
+                if (client->protocol >= PROTOCOL_VERSION && msg.length > 0) {
+                    since = read_varint(&reader);
+                }
+                bool page = client->protocol >= PROTOCOL_VERSION &&
+                            !reader.error && reader.offset < reader.length;
+
+                ByteBuffer* payload = begin_payload(state);
+                if (page) {
+                    uint8_t quiz = read_u8(&reader);
+                    uint32_t offset = read_varint(&reader);
+                    uint32_t limit = read_varint(&reader);
+                    uint8_t flags = read_u8(&reader);
+                    lock_players_read(state->players);
+                    bool built = !reader.error &&
+                                 encode_score_page(state, client->player, quiz, offset, limit, flags, payload);
+                    unlock_players(state->players);
+                    send_payload(state, client_socket, MSG_SCORE_PAGE, payload, built);
                     break;
                 }
-                strcpy(msg.payload, scores);
-                send_message(client_socket, &msg);
-                free(msg.payload);
-                free(scores);
+
+                // Le sole voci cambiate, se stanno in un pezzo: la risposta costruita
+                // per un solo client resta limitata come i pezzi della classifica
+                if (client->protocol >= PROTOCOL_VERSION && since != 0) {
+                    lock_players_read(state->players);
+                    bool built = encode_score_delta(state, since, SCOREBOARD_CHUNK_SIZE, payload);
+                    unlock_players(state->players);
+                    if (built) {
+                        send_payload(state, client_socket, MSG_SCORE, payload, true);
+                        break;
+                    }
+                }
+
+                // Altrimenti la classifica completa, quella in cache finché nessun
+                // punteggio cambia, inviata a pezzi
+                send_scoreboard(state, client_socket, MSG_SCORE,
+                                client->protocol >= PROTOCOL_VERSION ? SCOREBOARD_V2 : SCOREBOARD_TEXT, 0);
                 break;
             }
         
+        case MSG_REQUEST_RANK:
+            {
+                // Solo v2: la posizione del giocatore e le voci vicine in un quiz
+                ClientData* client = get_client(state, client_socket);
+                if (client->protocol < PROTOCOL_VERSION) break;
+
+                ByteBuffer* payload = begin_payload(state);
+                lock_players_read(state->players);
+                bool built = msg.length >= 1 &&
+                             encode_player_rank(state, client->player, (uint8_t)msg.payload[0], payload);
+                unlock_players(state->players);
+                send_payload(state, client_socket, MSG_RANK, payload, built);
+                break;
+            }
+
         case MSG_END_QUIZ: 
             {
-                ClientData* client = &client_data[client_socket];
+                ClientData* client = get_client(state, client_socket);
                 client->is_playing = false;
                 if (strlen(client->nickname) > 0) {
-                    mark_quiz_as_completed(state->players, client->nickname, 
-                                                    client->current_quiz == 1);
-                    
-                    Player* player = find_player(state->players, client->nickname);
-                    if (player) {
-                        player->is_connected = false;
-                    }
+                    lock_players_write(state->players);
+                    Player* player = lookup_player(state->players, client->player);
+                    mark_quiz_as_completed(state->players, player, client->current_quiz == 1);
+                    reset_player_connection(player);
+                    unlock_players(state->players);
                     
-                    memset(client, 0, sizeof(ClientData));
+                    // Il socket resta aperto, quindi lo slot rimane occupato
+                    // e si azzera solo lo stato di gioco
+                    client->nickname[0] = '\0';
+                    client->player = INVALID_PLAYER_HANDLE;
+                    client->current_quiz = 0;
+                    client->current_question = 0;
 
                     // Invia conferma al client
-                    Message response;
-                    response.type = MSG_QUIZ_COMPLETED;
-                    const char* text = "Quiz terminato. Ridirezione al menu principale.";
-                    response.length = strlen(text);
-                    response.payload = malloc(response.length + 1);
-                    if (response.payload) {
-                        strcpy(response.payload, text);
-                        send_message(client_socket, &response);
-                        free(response.payload);
-                    }
+                    send_status(state, client_socket, STATUS_QUIZ_ENDED);
                 }
                 break;
             }
@@ -632,58 +1556,585 @@ bool load_quiz_files() {
     return sport_quiz && geography_quiz;
 }
 
+void free_quiz_files() {
+    if (sport_quiz) free_quiz(sport_quiz);
+    if (geography_quiz) free_quiz(geography_quiz);
+    sport_quiz = NULL;
+    geography_quiz = NULL;
+}
+
+/* Motore io_uring */
+
+/**
+ * Rilascia un riferimento a una connessione io_uring e la libera all'ultimo
+ * @param state stato del worker
+ * @param conn connessione
+ * @note Ogni operazione in volo e il client stesso tengono un riferimento:
+ * in questo modo un CQE in ritardo non accede mai a memoria già liberata
+ */
+static void release_uring_connection(ServerState* state, UringConnection* conn) {
+    if (--conn->refs > 0) return;
+
+    if (conn->prev) conn->prev->next = conn->next;
+    else state->uring_connections = conn->next;
+    if (conn->next) conn->next->prev = conn->prev;
+
+    release_buffer(&conn->pending);
+    release_buffer(&conn->inflight);
+    free(conn);
+}
+
+/**
+ * Restituisce un SQE libero, sottomettendo quelli già pronti se la coda è piena
+ * @param ring istanza io_uring
+ * @return SQE da preparare o NULL se non è stato possibile liberare spazio
+ */
+static struct io_uring_sqe* next_uring_sqe(IoUring* ring) {
+    struct io_uring_sqe* sqe = uring_get_sqe(ring);
+    if (!sqe && uring_submit(ring, 0, -1) >= 0) {
+        sqe = uring_get_sqe(ring);
+    }
+    return sqe;
+}
+
+/**
+ * Arma l'accept multishot sul socket di ascolto del worker
+ * @param state stato del worker
+ * @return true se l'SQE è stato preparato, false altrimenti
+ */
+static bool arm_uring_accept(ServerState* state) {
+    struct io_uring_sqe* sqe = next_uring_sqe(state->ring);
+    if (!sqe) return false;
+
+    uring_prep(sqe, IORING_OP_ACCEPT, state->server_socket, NULL, 0, URING_OP_ACCEPT);
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    return true;
+}
+
+/**
+ * Arma la lettura del wakeup_fd, completata quando viene richiesto lo shutdown
+ * @param state stato del worker
+ * @return true se l'SQE è stato preparato, false altrimenti
+ */
+static bool arm_uring_wakeup(ServerState* state) {
+    struct io_uring_sqe* sqe = next_uring_sqe(state->ring);
+    if (!sqe) return false;
+
+    uring_prep(sqe, IORING_OP_READ, state->wakeup_fd, &state->wakeup_value,
+               sizeof(state->wakeup_value), URING_OP_WAKEUP);
+    return true;
+}
+
+/**
+ * Arma la recv multishot di una connessione usando i buffer forniti
+ * @param state stato del worker
+ * @param conn connessione
+ * @return true se l'SQE è stato preparato, false altrimenti
+ */
+static bool arm_uring_recv(ServerState* state, UringConnection* conn) {
+    struct io_uring_sqe* sqe = next_uring_sqe(state->ring);
+    if (!sqe) return false;
+
+    uring_prep(sqe, IORING_OP_RECV, conn->fd, NULL, 0, (uint64_t)(uintptr_t)conn | URING_OP_RECV);
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    conn->refs++;
+    return true;
+}
+
+/**
+ * Segnala che una connessione ha messaggi da inviare alla prossima sottomissione
+ * @param state stato del worker
+ * @param conn connessione
+ * @return true se la connessione è nella lista, false se la lista non può
+ * crescere: i messaggi accodati non partirebbero mai, quindi il chiamante
+ * deve chiudere la connessione
+ */
+static bool mark_uring_dirty(ServerState* state, UringConnection* conn) {
+    if (conn->dirty) return true;
+
+    if (state->dirty_count == state->dirty_capacity) {
+        int new_capacity = state->dirty_capacity > 0 ? state->dirty_capacity * 2 : INITIAL_CLIENT_TABLE_SIZE;
+        UringConnection** new_dirty = realloc(state->dirty_connections,
+                                              sizeof(UringConnection*) * new_capacity);
+        if (!new_dirty) return false;
+        state->dirty_connections = new_dirty;
+        state->dirty_capacity = new_capacity;
+    }
+
+    conn->dirty = true;
+    conn->refs++;  // La lista dei dirty tiene un riferimento
+    state->dirty_connections[state->dirty_count++] = conn;
+    return true;
+}
+
+ssize_t queue_uring_output(ServerState* state, int client_socket, const char* header,
+                           size_t header_size, const char* payload, size_t length) {
+    ClientData* client = get_client(state, client_socket);
+    UringConnection* conn = client->uring_conn;
+    if (!conn || conn->closed) return ERR_SEND;
+
+    // I messaggi di un'iterazione si accodano nello stesso buffer e partono con
+    // un'unica send; il payload viene copiato perché il chiamante lo libera subito
+    if (!append_to_buffer(&conn->pending, header, header_size) ||
+        (length > 0 && !append_to_buffer(&conn->pending, payload, length))) {
+        return ERR_SEND;
+    }
+
+    // Con una send già in volo si attende il suo completamento per preservare l'ordine.
+    // Se la connessione non entra nella lista l'errore arriva a queue_output(),
+    // che chiude il client come per una coda epoll non allocabile
+    if (conn->inflight.length == 0 && !mark_uring_dirty(state, conn)) {
+        return ERR_SEND;
+    }
+
+    return header_size + length;
+}
+
+/**
+ * Prepara la send dei byte in volo di una connessione non ancora confermati
+ * @param state stato del worker
+ * @param conn connessione con una send in volo
+ * @return true se l'SQE è stato preparato, false altrimenti
+ */
+static bool prep_uring_send(ServerState* state, UringConnection* conn) {
+    struct io_uring_sqe* sqe = next_uring_sqe(state->ring);
+    if (!sqe) return false;
+
+    uring_prep(sqe, IORING_OP_SEND, conn->fd, conn->inflight.data + conn->inflight_sent,
+               (unsigned)(conn->inflight.length - conn->inflight_sent),
+               (uint64_t)(uintptr_t)conn | URING_OP_SEND);
+    // MSG_WAITALL fa completare la send solo a invio totale avvenuto
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    conn->refs++;
+    return true;
+}
+
+/**
+ * Sottomette le send di tutte le connessioni con messaggi accodati
+ * @param state stato del worker
+ * @note Il buffer accodato diventa quello in volo, e il buffer già inviato
+ * viene riusato per i messaggi successivi senza nuove allocazioni
+ */
+static void flush_uring_sends(ServerState* state) {
+    // Una connessione rimasta senza spazio viene reinserita in una posizione
+    // già visitata, quindi la lista può essere riempita durante il ciclo
+    int count = state->dirty_count;
+    state->dirty_count = 0;
+
+    for (int i = 0; i < count; i++) {
+        UringConnection* conn = state->dirty_connections[i];
+        conn->dirty = false;
+        if (!conn->closed && conn->inflight.length == 0 && conn->pending.length > 0) {
+            ByteBuffer sent = conn->inflight;
+            conn->inflight = conn->pending;
+            conn->pending = sent;
+            conn->inflight_sent = 0;
+
+            if (!prep_uring_send(state, conn)) {
+                // Nessuno spazio nella submission queue: si riprova alla prossima iterazione
+                sent = conn->pending;
+                conn->pending = conn->inflight;
+                conn->inflight = sent;
+                if (!mark_uring_dirty(state, conn)) handle_disconnect(state, conn->fd);
+            }
+        }
+        release_uring_connection(state, conn);
+    }
+}
+
+/**
+ * Gestisce il completamento di un'accept multishot
+ * @param state stato del worker
+ * @param cqe completamento ricevuto
+ */
+static void handle_uring_accept(ServerState* state, const struct io_uring_cqe* cqe) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        // Il kernel ha disarmato l'accept multishot: va riarmata
+        arm_uring_accept(state);
+    }
+
+    if (cqe->res < 0) {
+        errno = -cqe->res;
+        perror("Errore nell'accept");
+        return;
+    }
+
+    int client_socket = cqe->res;
+    set_nodelay(client_socket);
+    UringConnection* conn = malloc(sizeof(UringConnection));
+    if (!conn || !init_client_data(state, client_socket)) {
+        fprintf(stderr, "Impossibile registrare il client con socket %d\n", client_socket);
+        free(conn);
+        close(client_socket);
+        return;
+    }
+
+    memset(conn, 0, sizeof(UringConnection));
+    conn->fd = client_socket;
+    conn->refs = 1;  // Riferimento del client, rilasciato in handle_disconnect
+    conn->next = state->uring_connections;
+    if (conn->next) conn->next->prev = conn;
+    state->uring_connections = conn;
+
+    get_client(state, client_socket)->uring_conn = conn;
+
+    if (!arm_uring_recv(state, conn)) {
+        handle_disconnect(state, client_socket);
+        return;
+    }
+
+#ifdef DEBUG
+    // Con l'accept multishot l'indirizzo del client si ricava dal socket
+    struct sockaddr_in client_addr;
+    socklen_t client_len = sizeof(client_addr);
+    if (getpeername(client_socket, (struct sockaddr*)&client_addr, &client_len) == 0) {
+        print_client_address(&client_addr);
+    }
+#endif
+}
+
+/**
+ * Gestisce il completamento di una recv multishot
+ * @param state stato del worker
+ * @param conn connessione a cui si riferisce il completamento
+ * @param cqe completamento ricevuto
+ */
+static void handle_uring_recv(ServerState* state, UringConnection* conn,
+                              const struct io_uring_cqe* cqe) {
+    int received = cqe->res;
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        unsigned short bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        bool appended = true;
+        if (received > 0 && !conn->closed) {
+            // La recv multishot non può essere sospesa: oltre il limite il client
+            // viene disconnesso invece di accumulare richieste senza fine
+            ClientData* client = get_client(state, conn->fd);
+            ByteBuffer* input = &client->input;
+            client->last_activity = state->now_ms;
+            appended = input->length < INPUT_HIGH_WATER_MARK &&
+                       append_to_buffer(input, uring_buffer(state->ring, bid), received);
+        }
+        // I byte sono stati copiati, il buffer torna subito al kernel
+        uring_recycle_buffer(state->ring, bid);
+
+        if (received > 0 && !conn->closed) {
+            if (appended) process_input_buffer(state, conn->fd);
+            else handle_disconnect(state, conn->fd);
+        }
+    }
+
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        // La recv multishot è terminata: si riarma se il client è ancora connesso,
+        // anche quando il kernel ha esaurito temporaneamente i buffer forniti
+        if (!conn->closed) {
+            if (received > 0 || received == -ENOBUFS) {
+                if (!arm_uring_recv(state, conn)) handle_disconnect(state, conn->fd);
+            } else {
+                DEBUG_PRINT("Ricezione fallita con codice %d\n", received);
+                handle_disconnect(state, conn->fd);
+            }
+        }
+        release_uring_connection(state, conn);
+    }
+}
+
+/**
+ * Gestisce il completamento di una send
+ * @param state stato del worker
+ * @param conn connessione a cui si riferisce il completamento
+ * @param cqe completamento ricevuto
+ */
+static void handle_uring_send(ServerState* state, UringConnection* conn,
+                              const struct io_uring_cqe* cqe) {
+    if (!conn->closed) {
+        if (cqe->res < 0) {
+            DEBUG_PRINT("Invio fallito con codice %d\n", cqe->res);
+            handle_disconnect(state, conn->fd);
+        } else if ((conn->inflight_sent += cqe->res) < conn->inflight.length) {
+            // Invio parziale: si sottomette il resto
+            if (!prep_uring_send(state, conn)) handle_disconnect(state, conn->fd);
+        } else {
+            conn->inflight.length = 0;
+            ClientData* client = get_client(state, conn->fd);
+            if (conn->pending.length > 0) {
+                if (!mark_uring_dirty(state, conn)) handle_disconnect(state, conn->fd);
+            } else if (client->stream) {
+                // Prosegue la classifica in corso: il pezzo accodato marca la connessione
+                if (!pump_client_stream(state, conn->fd)) handle_disconnect(state, conn->fd);
+            } else if (client->input.length > 0) {
+                // Uscita svuotata: si riprendono le richieste rimaste in sospeso
+                process_input_buffer(state, conn->fd);
+            }
+        }
+    }
+
+    release_uring_connection(state, conn);
+}
+
+/**
+ * Ciclo principale di un worker con motore io_uring
+ * @param state stato del worker
+ * @note Ad ogni iterazione tutti gli SQE preparati (send, riarmi) vengono
+ * sottomessi con la stessa io_uring_enter che attende i completamenti
+ */
+static void run_uring_loop(ServerState* state) {
+    if (!arm_uring_accept(state) || !arm_uring_wakeup(state)) {
+        fprintf(stderr, "Impossibile avviare il motore io_uring\n");
+        return;
+    }
+
+    bool running = true;
+    while (running) {
+        flush_uring_sends(state);
+        // Con messaggi ancora da elaborare si raccolgono i completamenti senza attendere
+        int timeout = state->ready_clients_count > 0 ? 0 :
+                      timer_wheel_timeout(state->timers, state->now_ms);
+        if (uring_submit(state->ring, 1, timeout) < 0) {
+            perror("Errore nella io_uring_enter");
+            break;
+        }
+        state->now_ms = timer_now_ms();
+
+        struct io_uring_cqe* next;
+        while ((next = uring_peek_cqe(state->ring)) != NULL) {
+            // Copia del CQE: lo slot torna al kernel prima di eseguire i gestori
+            struct io_uring_cqe cqe = *next;
+            uring_cqe_seen(state->ring);
+
+            UringConnection* conn = (UringConnection*)(uintptr_t)(cqe.user_data & ~(uint64_t)URING_OP_MASK);
+            switch (cqe.user_data & URING_OP_MASK) {
+                case URING_OP_ACCEPT:
+                    handle_uring_accept(state, &cqe);
+                    break;
+                case URING_OP_RECV:
+                    handle_uring_recv(state, conn, &cqe);
+                    break;
+                case URING_OP_SEND:
+                    handle_uring_send(state, conn, &cqe);
+                    break;
+                case URING_OP_WAKEUP:
+                    // Il thread principale ha richiesto lo shutdown
+                    running = false;
+                    break;
+            }
+        }
+
+        timer_wheel_advance(state->timers, state->now_ms, handle_client_timer, state);
+        process_ready_clients(state);
+    }
+}
+
+/* Funzioni dei worker */
+
+/**
+ * Ciclo principale di un worker con motore epoll
+ * @param state stato del worker
+ */
+static void run_epoll_loop(ServerState* state) {
+    bool running = true;
+
+    // Loop principale del worker: epoll restituisce solo i descrittori pronti
+    while (running) {
+        // L'attesa termina al più tardi alla prossima scadenza della timer wheel,
+        // subito se qualche client ha ancora messaggi da elaborare
+        int timeout = state->ready_clients_count > 0 ? 0 :
+                      timer_wheel_timeout(state->timers, state->now_ms);
+        int ready = event_loop_wait(state->loop, timeout);
+        if (ready < 0) {
+            perror("Errore nella epoll_wait");
+            break;
+        }
+        state->now_ms = timer_now_ms();
+
+        for (int i = 0; i < ready; i++) {
+            uint64_t token = state->loop->events[i].data.u64;
+            uint32_t events = state->loop->events[i].events;
+            if (token == EVENT_TOKEN_LISTENER) {
+                handle_new_connection(state);
+            } else if (token == EVENT_TOKEN_WAKEUP) {
+                // Il thread principale ha richiesto lo shutdown
+                running = false;
+            } else {
+                // Un client disconnesso in questo stesso batch non ha più un handle
+                // valido, anche se il suo socket è già stato riassegnato
+                ClientData* client = lookup_client(state, token);
+                if (!client) continue;
+
+                int fd = client->fd;
+                if (events & EPOLLOUT) {
+                    handle_client_writable(state, fd);
+                }
+                // EPOLLHUP/EPOLLERR vengono gestiti dalla recv fallita
+                if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && lookup_client(state, token)) {
+                    process_client_message(state, fd);
+                }
+            }
+        }
+
+        timer_wheel_advance(state->timers, state->now_ms, handle_client_timer, state);
+        process_ready_clients(state);
+        flush_dirty_clients(state);
+    }
+}
+
+void* run_worker(void* arg) {
+    ServerState* state = (ServerState*)arg;
+
+    if (state->engine == ENGINE_URING) {
+        run_uring_loop(state);
+    } else {
+        run_epoll_loop(state);
+    }
+
+    handle_shutdown(state);
+    return NULL;
+}
+
+/**
+ * Legge gli argomenti della riga di comando
+ * @param argc numero di argomenti
+ * @param argv argomenti
+ * @param config configurazione da riempire; le opzioni non specificate
+ * assumono i valori di default (1 worker, epoll, DEFAULT_LISTEN_BACKLOG,
+ * OUTPUT_HIGH_WATER_MARK)
+ * @return true se gli argomenti sono validi, false altrimenti
+ */
+static bool parse_arguments(int argc, char* argv[], ServerConfig* config) {
+    if (argc < 2 || argc % 2 != 0) return false;
+
+    config->port = atoi(argv[1]);
+    config->workers = 1;
+    config->engine = ENGINE_EPOLL;
+    config->backlog = DEFAULT_LISTEN_BACKLOG;
+    config->output_high_water = OUTPUT_HIGH_WATER_MARK;
+
+    for (int i = 2; i < argc; i += 2) {
+        if (strcmp(argv[i], "--workers") == 0) {
+            config->workers = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--engine") == 0 && strcmp(argv[i + 1], "epoll") == 0) {
+            config->engine = ENGINE_EPOLL;
+        } else if (strcmp(argv[i], "--engine") == 0 && strcmp(argv[i + 1], "uring") == 0) {
+            config->engine = ENGINE_URING;
+        } else if (strcmp(argv[i], "--backlog") == 0) {
+            config->backlog = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--high-water") == 0) {
+            config->output_high_water = strtoul(argv[i + 1], NULL, 10);
+        } else {
+            return false;
+        }
+    }
+
+    return config->port > 0 && config->workers >= 1 && config->workers <= MAX_WORKERS &&
+           config->backlog > 0 && config->output_high_water > 0;
+}
+
 /* Main del server */
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Utilizzo: %s <porta>\n", argv[0]);
+    ServerConfig config;
+    if (!parse_arguments(argc, argv, &config)) {
+        fprintf(stderr, "Utilizzo: %s <porta> [--workers N] [--engine epoll|uring] "
+                        "[--backlog N] [--high-water BYTE]\n", argv[0]);
+        fprintf(stderr, "N deve essere compreso tra 1 e %d\n", MAX_WORKERS);
         return 1;
     }
 
     // Inizializza il generatore di numeri casuali
     srand(time(NULL));
 
+    // Senza il limite di select() il tetto di client è dato da RLIMIT_NOFILE
+    raise_fd_limit();
+
     // Carica i quiz
     if (!load_quiz_files()) {
         fprintf(stderr, "Errore nel caricamento dei quiz\n");
+        free_quiz_files();
         return 1;
     }
 
-    ServerState* state = init_server("127.0.0.1", atoi(argv[1]));
-    if (!state) {
+    // Le risposte fisse vengono codificate una volta sola, prima dei worker
+    build_status_frames();
+
+    // L'array dei giocatori è unico e condiviso da tutti i worker
+    PlayerArray* players = create_player_array(INITIAL_PLAYER_ARRAY_SIZE);
+    if (!players) {
         fprintf(stderr, "Errore nell'inizializzazione del server\n");
+        free_quiz_files();
         return 1;
     }
 
-    DEBUG_PRINT("Server avviato sulla porta %s", argv[1]);
-    
-    server_state = state;  // Salva nel riferimento globale
-    display_server_status(state);
-
-    // Imposta i gestori dei segnali
-    signal(SIGINT, handle_shutdown);
-    signal(SIGTERM, handle_shutdown);
+    // Ogni worker ha il proprio socket di ascolto, condiviso con SO_REUSEPORT
+    ServerState* states[MAX_WORKERS];
+    for (int w = 0; w < config.workers; w++) {
+        states[w] = init_server("127.0.0.1", &config, players);
+        if (!states[w] && config.engine == ENGINE_URING) {
+            // io_uring può essere assente o disabilitato: si ripiega su epoll
+            fprintf(stderr, "io_uring non disponibile, uso epoll\n");
+            config.engine = ENGINE_EPOLL;
+            states[w] = init_server("127.0.0.1", &config, players);
+        }
+        if (!states[w]) {
+            fprintf(stderr, "Errore nell'inizializzazione del server\n");
+            for (int j = 0; j < w; j++) {
+                cleanup_server(states[j]);
+            }
+            free_player_array(players);
+            free_quiz_files();
+            return 1;
+        }
+    }
 
-    // Loop principale del server
-    while (1) {
-        state->read_fds = state->active_fds;
-        
-        if (select(state->max_fd + 1, &state->read_fds, NULL, NULL, NULL) < 0) {
-            perror("Errore nella select");
+    DEBUG_PRINT("Server avviato sulla porta %d con %d worker", config.port, config.workers);
+    display_server_status(states[0]);
+
+    // I segnali di terminazione e SIGUSR1 vengono bloccati in tutti i thread
+    // e raccolti solo dal thread principale con sigwait()
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    pthread_t threads[MAX_WORKERS];
+    int started = 0;
+    for (; started < config.workers; started++) {
+        if (pthread_create(&threads[started], NULL, run_worker, states[started]) != 0) {
+            fprintf(stderr, "Errore nella creazione del worker %d\n", started);
             break;
         }
+    }
 
-        for (int i = 0; i <= state->max_fd; i++) {
-            if (FD_ISSET(i, &state->read_fds)) {
-                if (i == state->server_socket) {
-                    handle_new_connection(state);
-                } else {
-                    process_client_message(state, i);
-                }
-            }
+    if (started == config.workers) {
+        // La classifica completa viene stampata solo su richiesta (kill -USR1):
+        // con molti giocatori ricalcolarla ad ogni login rallenterebbe i worker
+        int sig;
+        while (sigwait(&signals, &sig) == 0 && sig == SIGUSR1) {
+            display_server_status(states[0]);
         }
     }
 
-    cleanup_server(state);
+    // Sveglia ogni worker: chiuderà le proprie connessioni e terminerà
+    for (int w = 0; w < started; w++) {
+        uint64_t one = 1;
+        if (write(states[w]->wakeup_fd, &one, sizeof(one)) < 0) {
+            perror("Errore nella notifica di shutdown al worker");
+        }
+    }
+
+    for (int w = 0; w < started; w++) {
+        pthread_join(threads[w], NULL);
+    }
+
+    for (int w = 0; w < config.workers; w++) {
+        cleanup_server(states[w]);
+    }
+    free_scoreboard_cache();
+    free_player_array(players);
+    free_quiz_files();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,214 @@
+/*
+ * timer_wheel.c
+ * Implementazione del timer wheel gerarchico per 'Trivia Quiz Multiplayer'
+ *
+ * Il server usa questa struttura per le scadenze delle connessioni (login,
+ * inattività, messaggi rimasti a metà). Ogni livello divide il tempo in 64
+ * slot: il livello 0 ha slot da un tick, il livello 1 da 64 tick e così via.
+ * Un timer viene inserito nel livello più basso che ne contiene la scadenza
+ * e, quando il livello inferiore completa un giro, i timer dello slot
+ * corrispondente del livello superiore vengono ridistribuiti verso il basso.
+ */
+
+#include "include/timer_wheel.h"
+#include <stdlib.h>
+#include <time.h>
+
+// Numero di tick coperti dall'intera wheel
+#define TIMER_WHEEL_SPAN ((uint64_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+uint64_t timer_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Inserisce un timer in coda ad una lista circolare
+ * @param head sentinella della lista
+ * @param timer timer da inserire
+ */
+static void link_timer(Timer* head, Timer* timer) {
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+/**
+ * Rimuove un timer dalla lista in cui si trova
+ * @param timer timer da rimuovere
+ */
+static void unlink_timer(Timer* timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = NULL;
+    timer->next = NULL;
+}
+
+/**
+ * Inserisce un timer nello slot corrispondente alla sua scadenza
+ * @param wheel TimerWheel* di destinazione
+ * @param timer timer non attivo con expires non precedente a current
+ * @note Una scadenza pari a current finisce nello slot del tick corrente:
+ * è corretto solo durante la ridistribuzione, prima di servire quello slot
+ */
+static void insert_timer(TimerWheel* wheel, Timer* timer) {
+    uint64_t delta = timer->expires - wheel->current;
+    if (delta >= TIMER_WHEEL_SPAN) {
+        timer->expires = wheel->current + TIMER_WHEEL_SPAN - 1;
+        delta = TIMER_WHEEL_SPAN - 1;
+    }
+
+    // Livello più basso il cui giro contiene la scadenza
+    int level = 0;
+    while (delta >= ((uint64_t)1 << (TIMER_WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+
+    int slot = (timer->expires >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+    link_timer(&wheel->slots[level][slot], timer);
+}
+
+/**
+ * Ridistribuisce nei livelli inferiori i timer di uno slot
+ * @param wheel TimerWheel* da aggiornare
+ * @param level livello dello slot (almeno 1)
+ * @param slot indice dello slot
+ */
+static void cascade(TimerWheel* wheel, int level, int slot) {
+    Timer* head = &wheel->slots[level][slot];
+    while (head->next != head) {
+        Timer* timer = head->next;
+        unlink_timer(timer);
+        insert_timer(wheel, timer);
+    }
+}
+
+TimerWheel* create_timer_wheel(uint64_t tick_ms, uint64_t now_ms) {
+    if (tick_ms == 0) return NULL;
+
+    TimerWheel* wheel = malloc(sizeof(TimerWheel));
+    if (!wheel) return NULL;
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            Timer* head = &wheel->slots[level][slot];
+            head->prev = head;
+            head->next = head;
+        }
+    }
+
+    wheel->tick_ms = tick_ms;
+    wheel->current = now_ms / tick_ms;
+    wheel->count = 0;
+    return wheel;
+}
+
+void free_timer_wheel(TimerWheel* wheel) {
+    free(wheel);
+}
+
+void timer_wheel_schedule(TimerWheel* wheel, Timer* timer, uint64_t expires_ms) {
+    if (timer_is_active(timer)) {
+        unlink_timer(timer);
+    } else {
+        wheel->count++;
+    }
+
+    // Arrotondando per eccesso il timer non scade mai prima del previsto.
+    // Il tick corrente è già stato servito: una scadenza passata va al successivo
+    timer->expires = (expires_ms + wheel->tick_ms - 1) / wheel->tick_ms;
+    if (timer->expires <= wheel->current) {
+        timer->expires = wheel->current + 1;
+    }
+    insert_timer(wheel, timer);
+}
+
+void timer_wheel_cancel(TimerWheel* wheel, Timer* timer) {
+    if (timer_is_active(timer)) {
+        unlink_timer(timer);
+        wheel->count--;
+    }
+}
+
+bool timer_is_active(const Timer* timer) {
+    return timer->next != NULL;
+}
+
+int timer_wheel_timeout(TimerWheel* wheel, uint64_t now_ms) {
+    if (wheel->count == 0) return -1;
+
+    // Per il livello 0 il candidato è il primo slot non vuoto, per i livelli
+    // superiori l'inizio del primo blocco non vuoto, dove va ridistribuito.
+    // Un livello alto può richiedere una ridistribuzione prima della scadenza
+    // trovata in un livello più basso: serve il minimo su tutti i livelli
+    uint64_t wake_tick = UINT64_MAX;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        int shift = TIMER_WHEEL_BITS * level;
+        uint64_t block = wheel->current >> shift;
+
+        for (uint64_t next = block + 1; next <= block + TIMER_WHEEL_SLOTS; next++) {
+            Timer* head = &wheel->slots[level][next & (TIMER_WHEEL_SLOTS - 1)];
+            if (head->next != head) {
+                if ((next << shift) < wake_tick) wake_tick = next << shift;
+                break;
+            }
+        }
+    }
+    if (wake_tick == UINT64_MAX) wake_tick = wheel->current + 1;
+
+    uint64_t wake_ms = wake_tick * wheel->tick_ms;
+    if (wake_ms <= now_ms) return 0;
+
+    uint64_t timeout = wake_ms - now_ms;
+    return timeout > (uint64_t)INT32_MAX ? INT32_MAX : (int)timeout;
+}
+
+void timer_wheel_advance(TimerWheel* wheel, uint64_t now_ms, TimerCallback callback, void* ctx) {
+    uint64_t target = now_ms / wheel->tick_ms;
+
+    // Senza timer non serve scorrere i tick trascorsi
+    if (wheel->count == 0) {
+        if (target > wheel->current) wheel->current = target;
+        return;
+    }
+
+    while (wheel->current < target) {
+        wheel->current++;
+
+        // Al termine di un giro del livello inferiore si ridistribuisce lo slot
+        // del livello superiore, partendo dal più alto. Avviene prima di servire
+        // il tick: un timer che scade proprio all'inizio del blocco resta sul tick
+        // corrente invece di slittare al successivo
+        int top = 0;
+        while (top + 1 < TIMER_WHEEL_LEVELS &&
+               (wheel->current & (((uint64_t)1 << (TIMER_WHEEL_BITS * (top + 1))) - 1)) == 0) {
+            top++;
+        }
+        for (int level = top; level > 0; level--) {
+            cascade(wheel, level,
+                    (wheel->current >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1));
+        }
+
+        // Lo slot viene staccato prima delle callback, che possono riprogrammare
+        // o annullare altri timer, compresi quelli ancora da servire
+        Timer expired;
+        Timer* head = &wheel->slots[0][wheel->current & (TIMER_WHEEL_SLOTS - 1)];
+        if (head->next == head) continue;
+
+        expired.next = head->next;
+        expired.prev = head->prev;
+        expired.next->prev = &expired;
+        expired.prev->next = &expired;
+        head->next = head;
+        head->prev = head;
+
+        while (expired.next != &expired) {
+            Timer* timer = expired.next;
+            unlink_timer(timer);
+            wheel->count--;
+            callback(timer, ctx);
+        }
+    }
+}
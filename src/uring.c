@@ -0,0 +1,264 @@
+/*
+ * uring.c
+ * Interfaccia minimale verso io_uring per 'Trivia Quiz Multiplayer'
+ *
+ * Questo file contiene la configurazione di un'istanza io_uring tramite le
+ * system call dirette (senza liburing): mappatura degli anelli di submission
+ * e completion, pubblicazione degli SQE, lettura dei CQE e gestione
+ * dell'anello di buffer forniti al kernel per le recv multishot.
+ * La logica di accept/recv/send del server è in server.c.
+ */
+
+#include "include/uring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/**
+ * Wrapper della system call io_uring_setup
+ */
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+/**
+ * Wrapper della system call io_uring_enter
+ */
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                              void* arg, size_t arg_size) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+/**
+ * Wrapper della system call io_uring_register
+ */
+static int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/**
+ * Mappa in memoria gli anelli di submission e completion e l'array degli SQE
+ * @param ring istanza da completare
+ * @param params parametri restituiti da io_uring_setup
+ * @return true se le mappature hanno successo, false altrimenti
+ */
+static bool map_rings(IoUring* ring, struct io_uring_params* params) {
+    ring->sq_ring_size = params->sq_off.array + params->sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+
+    // Con SINGLE_MMAP i due anelli condividono la stessa mappatura
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        return false;
+    }
+
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            ring->cq_ring = NULL;
+            return false;
+        }
+    }
+
+    ring->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        return false;
+    }
+
+    char* sq = ring->sq_ring;
+    ring->sq_head = (unsigned*)(sq + params->sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params->sq_off.tail);
+    ring->sq_mask = *(unsigned*)(sq + params->sq_off.ring_mask);
+    ring->sq_entries = *(unsigned*)(sq + params->sq_off.ring_entries);
+    ring->sq_array = (unsigned*)(sq + params->sq_off.array);
+    ring->sq_local_tail = *ring->sq_tail;
+
+    char* cq = ring->cq_ring;
+    ring->cq_head = (unsigned*)(cq + params->cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params->cq_off.tail);
+    ring->cq_mask = *(unsigned*)(cq + params->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params->cq_off.cqes);
+    return true;
+}
+
+/**
+ * Alloca i buffer per le recv e li registra come gruppo di buffer forniti
+ * @param ring istanza io_uring
+ * @return true se la registrazione ha successo, false altrimenti
+ */
+static bool setup_buffer_ring(IoUring* ring) {
+    ring->buf_ring_size = ring->buf_count * sizeof(struct io_uring_buf);
+    ring->buf_ring = mmap(NULL, ring->buf_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring->buf_ring == MAP_FAILED) {
+        ring->buf_ring = NULL;
+        return false;
+    }
+
+    ring->buf_base = malloc((size_t)ring->buf_count * ring->buf_size);
+    if (!ring->buf_base) return false;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+    reg.ring_entries = ring->buf_count;
+    reg.bgid = URING_BUFFER_GROUP;
+    if (sys_io_uring_register(ring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return false;
+    }
+
+    // Inizialmente tutti i buffer sono a disposizione del kernel
+    ring->buf_tail = 0;
+    for (unsigned i = 0; i < ring->buf_count; i++) {
+        uring_recycle_buffer(ring, (unsigned short)i);
+    }
+    return true;
+}
+
+IoUring* create_uring(unsigned entries, unsigned buf_count, unsigned buf_size) {
+    IoUring* ring = malloc(sizeof(IoUring));
+    if (!ring) return NULL;
+    memset(ring, 0, sizeof(IoUring));
+    ring->buf_count = buf_count;
+    ring->buf_size = buf_size;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->ring_fd = sys_io_uring_setup(entries, &params);
+    if (ring->ring_fd < 0) {
+        perror("Errore nella creazione dell'istanza io_uring");
+        free(ring);
+        return NULL;
+    }
+
+    // Il timeout dell'attesa viene passato a io_uring_enter (kernel 5.11+)
+    if (!(params.features & IORING_FEAT_EXT_ARG)) {
+        fprintf(stderr, "io_uring non supporta il timeout nell'attesa\n");
+        close(ring->ring_fd);
+        free(ring);
+        return NULL;
+    }
+
+    if (!map_rings(ring, &params) || !setup_buffer_ring(ring)) {
+        perror("Errore nella configurazione di io_uring");
+        free_uring(ring);
+        return NULL;
+    }
+
+    return ring;
+}
+
+void free_uring(IoUring* ring) {
+    if (!ring) return;
+
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring) munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->ring_fd);
+
+    // L'anello dei buffer va liberato solo dopo la chiusura dell'istanza
+    if (ring->buf_ring) munmap(ring->buf_ring, ring->buf_ring_size);
+    free(ring->buf_base);
+    free(ring);
+}
+
+struct io_uring_sqe* uring_get_sqe(IoUring* ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head >= ring->sq_entries) {
+        return NULL;  // Coda piena
+    }
+
+    unsigned index = ring->sq_local_tail & ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    ring->sq_array[index] = index;
+    ring->sq_local_tail++;
+
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+void uring_prep(struct io_uring_sqe* sqe, int opcode, int fd,
+                const void* addr, unsigned len, uint64_t user_data) {
+    sqe->opcode = (uint8_t)opcode;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->len = len;
+    sqe->user_data = user_data;
+}
+
+int uring_submit(IoUring* ring, unsigned wait_nr, int timeout_ms) {
+    unsigned to_submit = ring->sq_local_tail - *ring->sq_tail;
+
+    // Pubblica gli SQE preparati: il kernel li vede solo dopo lo store della coda
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    if (to_submit == 0 && wait_nr == 0) return 0;
+
+    unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    if (wait_nr == 0 || timeout_ms < 0) {
+        int submitted = sys_io_uring_enter(ring->ring_fd, to_submit, wait_nr, flags, NULL, 0);
+        return submitted < 0 && errno == EINTR ? 0 : submitted;
+    }
+
+    // Attesa limitata: come per epoll_wait, lo scadere del timeout non è un errore
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t)(uintptr_t)&ts;
+
+    int submitted = sys_io_uring_enter(ring->ring_fd, to_submit, wait_nr,
+                                       flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (submitted < 0 && (errno == EINTR || errno == ETIME)) {
+        return 0;
+    }
+    return submitted;
+}
+
+struct io_uring_cqe* uring_peek_cqe(IoUring* ring) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail) return NULL;
+
+    return &ring->cqes[head & ring->cq_mask];
+}
+
+void uring_cqe_seen(IoUring* ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+char* uring_buffer(IoUring* ring, unsigned short bid) {
+    return ring->buf_base + (size_t)bid * ring->buf_size;
+}
+
+void uring_recycle_buffer(IoUring* ring, unsigned short bid) {
+    struct io_uring_buf* buf = &ring->buf_ring->bufs[ring->buf_tail & (ring->buf_count - 1)];
+    buf->addr = (uint64_t)(uintptr_t)uring_buffer(ring, bid);
+    buf->len = ring->buf_size;
+    buf->bid = bid;
+    ring->buf_tail++;
+
+    // La coda dell'anello si trova nel campo resv del primo elemento
+    __atomic_store_n(&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,334 @@
+/*
+ * test_replay.c
+ * Test di 'Trivia Quiz Multiplayer': un quiz interrotto non si può rigiocare
+ *
+ * Avvia il server, gioca due domande del quiz Sport con un client v2, prova a
+ * ricominciare il quiz in corso (il server risponde con MSG_ERROR), si disconnette a metà e si riconnette con lo
+ * stesso nickname. Il quiz interrotto deve risultare completato e il punteggio
+ * deve restare quello ottenuto prima della disconnessione.
+ *
+ * Verifica anche che le richieste della classifica non valide ricevano
+ * MSG_ERROR invece di lasciare il client in attesa.
+ *
+ * Va eseguito dalla radice del progetto (make test), dove si trovano
+ * l'eseguibile del server e i file dei quiz.
+ */
+
+#include "include/common.h"
+#include "include/protocol.h"
+#include "include/quiz.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define TEST_PORT "5957"
+#define TEST_NICKNAME "replay"
+
+static int failures = 0;
+
+#define CHECK(condition, description) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "FALLITO: %s (%s:%d)\n", description, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+/**
+ * Riceve un messaggio v2 e ne verifica il tipo
+ * @param sock socket del client
+ * @param type tipo atteso
+ * @param msg destinazione del messaggio, il cui payload va liberato dal chiamante
+ * @return true se è arrivato un messaggio del tipo atteso
+ */
+static bool expect_message(int sock, MessageType type, Message* msg) {
+    msg->payload = NULL;
+    if (receive_message(sock, msg, PROTOCOL_VERSION) < 0) return false;
+    if (msg->type != type) {
+        fprintf(stderr, "Atteso %s, ricevuto %s\n",
+                message_type_to_string(type), message_type_to_string(msg->type));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Invia un messaggio v2 con un payload di un byte
+ * @param sock socket del client
+ * @param type tipo del messaggio
+ * @param value byte del payload
+ * @return true se il messaggio è stato inviato
+ */
+static bool send_byte(int sock, MessageType type, uint8_t value) {
+    Message msg;
+    msg.type = type;
+    msg.length = 1;
+    msg.payload = (char*)&value;
+    return send_message(sock, &msg, PROTOCOL_VERSION) >= 0;
+}
+
+/**
+ * Si connette al server, negozia il protocollo v2 ed effettua il login
+ * @param status destinazione del codice di stato del login
+ * @param mask destinazione della maschera dei quiz disponibili
+ * @return socket connesso o -1 in caso di errore
+ * @note Se il server non ha ancora elaborato una disconnessione precedente
+ * il nickname risulta in uso: il login viene ritentato
+ */
+static int login(StatusCode* status, uint8_t* mask) {
+    for (int attempt = 0; attempt < 50; attempt++) {
+        int sock = setup_connection("127.0.0.1", atoi(TEST_PORT));
+        if (sock < 0) {
+            usleep(100 * 1000);
+            continue;
+        }
+
+        // La negoziazione viaggia ancora in framing v1
+        Message msg;
+        uint8_t version = PROTOCOL_VERSION;
+        msg.type = MSG_LOGIN;
+        msg.length = 1;
+        msg.payload = (char*)&version;
+        send_message(sock, &msg, PROTOCOL_VERSION_LEGACY);
+        msg.payload = NULL;
+        if (receive_message(sock, &msg, PROTOCOL_VERSION_LEGACY) < 0 || msg.type != MSG_VERSION) {
+            free(msg.payload);
+            close(sock);
+            return -1;
+        }
+        free(msg.payload);
+
+        if (!expect_message(sock, MSG_NICKNAME_PROMPT, &msg)) {
+            close(sock);
+            return -1;
+        }
+        free(msg.payload);
+
+        msg.type = MSG_REQUEST_NICKNAME;
+        msg.length = strlen(TEST_NICKNAME);
+        msg.payload = TEST_NICKNAME;
+        send_message(sock, &msg, PROTOCOL_VERSION);
+
+        msg.payload = NULL;
+        if (receive_message(sock, &msg, PROTOCOL_VERSION) < 0 || msg.length < 1) {
+            free(msg.payload);
+            close(sock);
+            return -1;
+        }
+        *status = (uint8_t)msg.payload[0];
+        free(msg.payload);
+
+        if (*status == STATUS_LOGIN_NICKNAME_IN_USE) {
+            close(sock);
+            usleep(100 * 1000);
+            continue;
+        }
+        if (msg.type != MSG_LOGIN_SUCCESS || !expect_message(sock, MSG_QUIZ_AVAILABLE, &msg)) {
+            close(sock);
+            return -1;
+        }
+        *mask = msg.length > 0 ? (uint8_t)msg.payload[0] : 0;
+        free(msg.payload);
+        return sock;
+    }
+    return -1;
+}
+
+/**
+ * Risponde correttamente ad una domanda ricevuta in un payload v2 di MSG_QUESTION
+ * @param sock socket del client
+ * @param quiz quiz caricato dagli stessi file del server
+ * @param reader cursore posizionato all'inizio del payload della domanda
+ * @param number destinazione del numero della domanda
+ * @return true se la domanda è stata riconosciuta e la risposta inviata
+ */
+static bool answer_correctly(int sock, Quiz* quiz, PayloadReader* reader, int* number) {
+    size_t length;
+    read_u8(reader);
+    *number = read_u8(reader);
+    read_string(reader, &length);
+    const char* text = read_string(reader, &length);
+    if (reader->error) return false;
+
+    for (int i = 0; i < quiz->total_count; i++) {
+        Question* question = &quiz->questions[i];
+        if (strlen(question->question) != length || memcmp(question->question, text, length) != 0) {
+            continue;
+        }
+
+        Message msg;
+        msg.type = MSG_ANSWER;
+        msg.length = strlen(question->correct_answers[0]);
+        msg.payload = question->correct_answers[0];
+        return send_message(sock, &msg, PROTOCOL_VERSION) >= 0;
+    }
+    return false;
+}
+
+/**
+ * Riceve l'esito di una risposta e la domanda successiva
+ * @param sock socket del client
+ * @param msg destinazione del messaggio, il cui payload va liberato dal chiamante
+ * @param reader cursore posizionato sul payload della domanda successiva
+ * @return true se la risposta era corretta ed è seguita da un'altra domanda
+ */
+static bool expect_correct_and_next(int sock, Message* msg, PayloadReader* reader) {
+    if (!expect_message(sock, MSG_ANSWER_NEXT, msg)) return false;
+
+    init_payload_reader(reader, msg->payload, msg->length);
+    uint8_t status = read_u8(reader);
+    uint8_t next = read_u8(reader);
+    return !reader->error && status == STATUS_ANSWER_CORRECT && next == MSG_QUESTION;
+}
+
+static void test_interrupted_quiz_cannot_be_replayed(Quiz* sport) {
+    StatusCode status;
+    uint8_t mask;
+    int sock = login(&status, &mask);
+    CHECK(sock >= 0, "login del nuovo giocatore");
+    if (sock < 0) return;
+    CHECK(status == STATUS_LOGIN_NEW, "il giocatore è nuovo");
+    CHECK(mask == (QUIZ_MASK_SPORT | QUIZ_MASK_GEOGRAPHY), "entrambi i quiz disponibili");
+
+    Message msg;
+    PayloadReader reader;
+    int number = 0;
+    send_byte(sock, MSG_REQUEST_QUESTION, 1);
+    CHECK(expect_message(sock, MSG_QUESTION, &msg), "prima domanda");
+    init_payload_reader(&reader, msg.payload, msg.length);
+    CHECK(answer_correctly(sock, sport, &reader, &number), "risposta alla prima domanda");
+    free(msg.payload);
+
+    CHECK(expect_correct_and_next(sock, &msg, &reader), "prima risposta corretta");
+    CHECK(answer_correctly(sock, sport, &reader, &number), "risposta alla seconda domanda");
+    free(msg.payload);
+
+    CHECK(expect_correct_and_next(sock, &msg, &reader), "seconda risposta corretta");
+    free(msg.payload);
+
+    // Selezionare di nuovo il quiz in corso non lo fa ripartire dalla prima
+    // domanda: la richiesta viene rifiutata con un errore e la risposta
+    // successiva è la posizione
+    send_byte(sock, MSG_REQUEST_QUESTION, 1);
+    send_byte(sock, MSG_REQUEST_RANK, 1);
+    CHECK(expect_message(sock, MSG_ERROR, &msg), "la nuova selezione riceve una risposta");
+    CHECK(msg.length == 1 && (uint8_t)msg.payload[0] == STATUS_QUIZ_IN_PROGRESS,
+          "il quiz in corso non ricomincia");
+    free(msg.payload);
+    CHECK(expect_message(sock, MSG_RANK, &msg), "posizione durante il quiz");
+    free(msg.payload);
+
+    // Disconnessione a metà quiz
+    close(sock);
+
+    sock = login(&status, &mask);
+    CHECK(sock >= 0, "login dopo la disconnessione");
+    if (sock < 0) return;
+    CHECK(status == STATUS_LOGIN_RETURNING, "il giocatore viene riconosciuto");
+    CHECK(mask == QUIZ_MASK_GEOGRAPHY, "il quiz interrotto risulta completato");
+
+    send_byte(sock, MSG_REQUEST_QUESTION, 1);
+    CHECK(expect_message(sock, MSG_QUIZ_AVAILABLE, &msg), "risposta alla selezione del quiz interrotto");
+    CHECK(msg.length == 2 && (uint8_t)msg.payload[1] == STATUS_QUIZ_UNAVAILABLE,
+          "il quiz interrotto non si può rigiocare");
+    free(msg.payload);
+
+    send_byte(sock, MSG_REQUEST_RANK, 1);
+    CHECK(expect_message(sock, MSG_RANK, &msg), "posizione nel quiz Sport");
+    init_payload_reader(&reader, msg.payload, msg.length);
+    read_u8(&reader);
+    read_varint(&reader);
+    uint32_t rank = read_varint(&reader);
+    uint32_t score = read_varint(&reader);
+    CHECK(!reader.error && rank == 1, "il giocatore è primo in classifica");
+    CHECK(score == 2, "il punteggio resta quello ottenuto prima della disconnessione");
+    free(msg.payload);
+
+    close(sock);
+}
+
+/**
+ * Verifica che la risposta successiva sia MSG_ERROR con STATUS_REQUEST_FAILED
+ * @param sock socket del client
+ * @return true se è arrivato l'errore atteso
+ */
+static bool expect_request_failed(int sock) {
+    Message msg;
+    bool failed = expect_message(sock, MSG_ERROR, &msg) &&
+                  msg.length == 1 && (uint8_t)msg.payload[0] == STATUS_REQUEST_FAILED;
+    free(msg.payload);
+    return failed;
+}
+
+static void test_invalid_requests_get_an_error(void) {
+    StatusCode status;
+    uint8_t mask;
+    int sock = login(&status, &mask);
+    CHECK(sock >= 0, "login per le richieste non valide");
+    if (sock < 0) return;
+
+    // Pagina di un quiz inesistente: [versione][quiz][posizione][voci][flag]
+    const char page[] = {1, 9, 0, 10, 0};
+    Message msg;
+    msg.type = MSG_REQUEST_SCORE;
+    msg.length = sizeof(page);
+    msg.payload = (char*)page;
+    send_message(sock, &msg, PROTOCOL_VERSION);
+    CHECK(expect_request_failed(sock), "pagina di un quiz inesistente");
+
+    // Pagina troncata dopo il quiz
+    msg.length = 2;
+    send_message(sock, &msg, PROTOCOL_VERSION);
+    CHECK(expect_request_failed(sock), "pagina troncata");
+
+    send_byte(sock, MSG_REQUEST_RANK, 9);
+    CHECK(expect_request_failed(sock), "posizione in un quiz inesistente");
+
+    msg.type = MSG_REQUEST_RANK;
+    msg.length = 0;
+    msg.payload = NULL;
+    send_message(sock, &msg, PROTOCOL_VERSION);
+    CHECK(expect_request_failed(sock), "posizione senza quiz");
+
+    // Dopo gli errori la connessione continua a rispondere
+    send_byte(sock, MSG_REQUEST_RANK, 1);
+    CHECK(expect_message(sock, MSG_RANK, &msg), "posizione dopo gli errori");
+    free(msg.payload);
+
+    close(sock);
+}
+
+int main(void) {
+    Quiz* sport = load_quiz("res/sport_quiz.txt");
+    if (!sport) {
+        fprintf(stderr, "Impossibile caricare res/sport_quiz.txt\n");
+        return 1;
+    }
+
+    pid_t server = fork();
+    if (server == 0) {
+        // Lo stato stampato dal server non serve al test
+        freopen("/dev/null", "w", stdout);
+        execl("./server", "./server", TEST_PORT, (char*)NULL);
+        perror("execl");
+        _exit(127);
+    }
+    // Il login ritenta la connessione, ma di solito basta attendere l'avvio
+    usleep(200 * 1000);
+
+    test_interrupted_quiz_cannot_be_replayed(sport);
+    test_invalid_requests_get_an_error();
+
+    kill(server, SIGINT);
+    waitpid(server, NULL, 0);
+    free_quiz(sport);
+
+    if (failures > 0) {
+        fprintf(stderr, "%d verifiche fallite\n", failures);
+        return 1;
+    }
+    printf("test_replay: OK\n");
+    return 0;
+}
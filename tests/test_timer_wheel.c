@@ -0,0 +1,106 @@
+/*
+ * test_timer_wheel.c
+ * Test di 'Trivia Quiz Multiplayer': scadenze del timer wheel gerarchico
+ *
+ * Simula il ciclo di eventi del server: attende il timeout indicato dalla
+ * wheel, la fa avanzare e registra l'istante in cui scade ogni timer. Un
+ * timer non deve mai scadere dopo la propria scadenza, nemmeno quando si
+ * trova in un livello alto mentre un livello più basso ha altri timer, o
+ * quando la scadenza cade esattamente all'inizio di un blocco.
+ */
+
+#include "include/timer_wheel.h"
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(condition, description) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "FALLITO: %s (%s:%d)\n", description, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+#define TIMER_COUNT 2
+
+/**
+ * Stato del ciclo di eventi simulato
+ * @param now_ms tempo simulato corrente
+ * @param fired_ms istante di scadenza osservato per ogni timer (0 se non scaduto)
+ */
+typedef struct {
+    uint64_t now_ms;
+    uint64_t fired_ms[TIMER_COUNT];
+} Clock;
+
+static void record_expiry(Timer* timer, void* ctx) {
+    Clock* clock = ctx;
+    clock->fired_ms[timer->owner] = clock->now_ms;
+}
+
+/**
+ * Fa avanzare il tempo simulato seguendo i timeout della wheel
+ * @param wheel TimerWheel* da far avanzare
+ * @param clock ciclo di eventi simulato
+ * @param until_ms istante oltre il quale fermarsi
+ */
+static void run_until(TimerWheel* wheel, Clock* clock, uint64_t until_ms) {
+    while (clock->now_ms < until_ms) {
+        int timeout = timer_wheel_timeout(wheel, clock->now_ms);
+        if (timeout < 0 || clock->now_ms + timeout > until_ms) {
+            clock->now_ms = until_ms;
+        } else {
+            clock->now_ms += timeout;
+        }
+        timer_wheel_advance(wheel, clock->now_ms, record_expiry, clock);
+    }
+}
+
+static void test_higher_level_cascade_is_not_skipped(void) {
+    Clock clock = {0};
+    TimerWheel* wheel = create_timer_wheel(1, clock.now_ms);
+    Timer timers[TIMER_COUNT] = {{0}};
+    for (int i = 0; i < TIMER_COUNT; i++) timers[i].owner = i;
+
+    // A sta nel livello 2 e va ridistribuito a 4096, prima di scadere a 4100
+    timer_wheel_schedule(wheel, &timers[0], 4100);
+    clock.now_ms = 4000;
+    timer_wheel_advance(wheel, clock.now_ms, record_expiry, &clock);
+
+    // B, nel livello 1, non deve nascondere la ridistribuzione di A
+    timer_wheel_schedule(wheel, &timers[1], 8000);
+    CHECK(timer_wheel_timeout(wheel, clock.now_ms) == 96, "risveglio alla ridistribuzione del livello 2");
+
+    run_until(wheel, &clock, 10000);
+    CHECK(clock.fired_ms[0] == 4100, "il timer del livello 2 scade in tempo");
+    CHECK(clock.fired_ms[1] == 8000, "il timer all'inizio di un blocco scade in tempo");
+    free_timer_wheel(wheel);
+}
+
+static void test_block_boundary_expires_on_time(void) {
+    Clock clock = {0};
+    TimerWheel* wheel = create_timer_wheel(1, clock.now_ms);
+    Timer timers[TIMER_COUNT] = {{0}};
+    for (int i = 0; i < TIMER_COUNT; i++) timers[i].owner = i;
+
+    // Scadenze esattamente all'inizio di un blocco del livello 1 e del livello 2
+    timer_wheel_schedule(wheel, &timers[0], 128);
+    timer_wheel_schedule(wheel, &timers[1], 8192);
+
+    run_until(wheel, &clock, 10000);
+    CHECK(clock.fired_ms[0] == 128, "scadenza all'inizio di un blocco del livello 1");
+    CHECK(clock.fired_ms[1] == 8192, "scadenza all'inizio di un blocco del livello 2");
+    free_timer_wheel(wheel);
+}
+
+int main(void) {
+    test_higher_level_cascade_is_not_skipped();
+    test_block_boundary_expires_on_time();
+
+    if (failures > 0) {
+        fprintf(stderr, "%d verifiche fallite\n", failures);
+        return 1;
+    }
+    printf("test_timer_wheel: OK\n");
+    return 0;
+}